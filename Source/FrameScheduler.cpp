@@ -0,0 +1,108 @@
+#include "FrameScheduler.h"
+
+namespace {
+    // Exponential moving average weight for new timing samples
+    const double timingSmoothing = 0.1;
+
+    // Fractions of the frame budget at which the render scale is changed
+    const double overBudgetThreshold = 0.9;
+    const double underBudgetThreshold = 0.6;
+
+    // Number of consecutive frames needed before acting, so a single slow frame doesn't cause flicker
+    const int framesBeforeDownscale = 5;
+    const int framesBeforeUpscale = 60;
+
+    const float downscaleStep = 0.85f;
+    const float upscaleStep = 1.05f;
+
+    // Clamp the animation timestep so a stall doesn't make the camera jump
+    const double maxDeltaTime = 0.1;
+}
+
+FrameScheduler::FrameScheduler() {
+}
+
+void FrameScheduler::setTargetFrameRate(double framesPerSecond) {
+    jassert(framesPerSecond > 0.0);
+    targetFrameRate = framesPerSecond;
+}
+
+double FrameScheduler::getTargetFrameRate() const {
+    return targetFrameRate;
+}
+
+double FrameScheduler::getFrameBudgetMs() const {
+    return 1000.0 / targetFrameRate;
+}
+
+void FrameScheduler::setRenderScaleLimits(float minScale, float maxScale) {
+    jassert(minScale > 0.0f && minScale <= maxScale && maxScale <= 1.0f);
+    minRenderScale = minScale;
+    maxRenderScale = maxScale;
+    renderScale = juce::jlimit(minRenderScale, maxRenderScale, renderScale);
+}
+
+float FrameScheduler::getRenderScale() const {
+    return renderScale;
+}
+
+void FrameScheduler::beginFrame() {
+    frameStart = Clock::now();
+
+    if (hasLastFrame) {
+        deltaTime = juce::jmin(maxDeltaTime, std::chrono::duration<double>(frameStart - lastFrameStart).count());
+    }
+    else {
+        deltaTime = 0.0;
+        hasLastFrame = true;
+    }
+    lastFrameStart = frameStart;
+}
+
+void FrameScheduler::endFrame(double gpuMs) {
+    double cpuMs = std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count();
+    averageCpuMs += timingSmoothing * (cpuMs - averageCpuMs);
+
+    if (gpuMs >= 0.0) {
+        averageGpuMs += timingSmoothing * (gpuMs - averageGpuMs);
+    }
+
+    adjustRenderScale();
+}
+
+double FrameScheduler::getDeltaTime() const {
+    return deltaTime;
+}
+
+double FrameScheduler::getAverageCpuMs() const {
+    return averageCpuMs;
+}
+
+double FrameScheduler::getAverageGpuMs() const {
+    return averageGpuMs;
+}
+
+void FrameScheduler::adjustRenderScale() {
+    // CPU and GPU work overlap, so the slower of the two is what limits the frame
+    auto frameCostMs = juce::jmax(averageCpuMs, averageGpuMs);
+    auto budgetMs = getFrameBudgetMs();
+
+    if (frameCostMs > overBudgetThreshold * budgetMs) {
+        framesUnderBudget = 0;
+        if (++framesOverBudget >= framesBeforeDownscale) {
+            renderScale = juce::jmax(minRenderScale, renderScale * downscaleStep);
+            framesOverBudget = 0;
+        }
+    }
+    else if (frameCostMs < underBudgetThreshold * budgetMs) {
+        framesOverBudget = 0;
+        if (++framesUnderBudget >= framesBeforeUpscale) {
+            renderScale = juce::jmin(maxRenderScale, renderScale * upscaleStep);
+            framesUnderBudget = 0;
+        }
+    }
+    else {
+        framesOverBudget = 0;
+        framesUnderBudget = 0;
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+#include <chrono>
+
+// Per-window frame pacing. Measures how long each frame takes on the CPU and
+// (when timer queries are available) on the GPU, and lowers the internal
+// render resolution while the window is over its frame budget.
+class FrameScheduler {
+public:
+	FrameScheduler();
+
+	void setTargetFrameRate(double framesPerSecond);
+	double getTargetFrameRate() const;
+	double getFrameBudgetMs() const;
+
+	void setRenderScaleLimits(float minScale, float maxScale);
+	float getRenderScale() const;
+
+	// Called from the render thread at the start and end of every frame.
+	// Pass a negative gpuMs when no GPU timing is available for this frame.
+	void beginFrame();
+	void endFrame(double gpuMs);
+
+	double getDeltaTime() const;
+	double getAverageCpuMs() const;
+	double getAverageGpuMs() const;
+
+private:
+	using Clock = std::chrono::high_resolution_clock;
+
+	void adjustRenderScale();
+
+	std::atomic<double> targetFrameRate{ 60.0 };
+
+	Clock::time_point frameStart;
+	Clock::time_point lastFrameStart;
+	bool hasLastFrame = false;
+	double deltaTime = 0.0;
+
+	double averageCpuMs = 0.0;
+	double averageGpuMs = 0.0;
+
+	float renderScale = 1.0f;
+	float minRenderScale = 0.5f;
+	float maxRenderScale = 1.0f;
+	int framesOverBudget = 0;
+	int framesUnderBudget = 0;
+};
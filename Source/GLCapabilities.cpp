@@ -0,0 +1,42 @@
+#include "GLCapabilities.h"
+
+GLCapabilities GLCapabilities::detect() {
+    using namespace ::juce::gl;
+
+    GLCapabilities capabilities;
+
+    // "major.minor[.release] vendor info", or "OpenGL ES major.minor ..." on GLES; both numbers are 0 if it can't be read
+    auto* versionString = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+    juce::String version(versionString != nullptr ? versionString : "");
+#if JUCE_OPENGL_ES
+    version = version.fromFirstOccurrenceOf("OpenGL ES", false, true).trimStart();
+#endif
+    capabilities.majorVersion = version.upToFirstOccurrenceOf(".", false, false).getIntValue();
+    capabilities.minorVersion = version.fromFirstOccurrenceOf(".", false, false).getIntValue();
+
+#if JUCE_OPENGL_ES
+    capabilities.hasTimerQueries = false;
+    capabilities.canRenderOffscreen = false;
+    auto hasInstancingVersion = capabilities.isAtLeast(3, 0);
+#else
+    capabilities.hasTimerQueries = capabilities.isAtLeast(3, 3) || juce::OpenGLHelpers::isExtensionSupported("GL_ARB_timer_query");
+    capabilities.canRenderOffscreen = capabilities.isAtLeast(3, 0) || juce::OpenGLHelpers::isExtensionSupported("GL_ARB_framebuffer_object");
+    auto hasInstancingVersion = capabilities.isAtLeast(3, 3);
+#endif
+
+    // Some drivers report a version without exporting every entry point, so the functions themselves are checked too
+    capabilities.canDrawInstanced = hasInstancingVersion && glDrawArraysInstanced != nullptr && glVertexAttribDivisor != nullptr;
+
+    return capabilities;
+}
+
+bool GLCapabilities::isAtLeast(int major, int minor) const {
+    return majorVersion > major || (majorVersion == major && minorVersion >= minor);
+}
+
+juce::String GLCapabilities::getDescription() const {
+    return "OpenGL " + juce::String(majorVersion) + "." + juce::String(minorVersion)
+        + (hasTimerQueries ? ", GPU timing" : ", no GPU timing")
+        + (canRenderOffscreen ? ", reduced resolution frames" : ", full resolution frames only")
+        + (canDrawInstanced ? ", instanced particles" : ", one draw call per particle");
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <JuceHeader.h>
+
+// What the current OpenGL context can do beyond the GL 2.1 / GLES 2.0 baseline everything else assumes.
+// Read once per context in OpenGLWindow::initialise() and handed to whatever needs it.
+struct GLCapabilities {
+	int majorVersion = 0;
+	int minorVersion = 0;
+
+	bool hasTimerQueries = false;
+	bool canRenderOffscreen = false;
+	bool canDrawInstanced = false;
+
+	// Must be called with the context active
+	static GLCapabilities detect();
+
+	bool isAtLeast(int major, int minor) const;
+	juce::String getDescription() const;
+};
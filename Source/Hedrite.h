@@ -7,6 +7,9 @@ public:
 	static Hedrite* instance;
 	static void Hedrite::openGLCallback();
 
+	// The instrument's geometry. Needs no GL context, so it can also be drawn with OpenGLWindow::renderSnapshot alone.
+	static std::vector<OpenGLWindow::Shape> createShapes();
+
 	std::unique_ptr<OpenGLWindow> openGLWindow;
 
 	Hedrite();
@@ -0,0 +1,111 @@
+#include "HedriteSynthesiser.h"
+#include "RealtimeGuard.h"
+
+namespace {
+    // A voice renders a sample in about 6 ns and handing a job to a pool thread and back takes about 7 us, so a block
+    // only goes parallel with this much work in total and at least a hand-off's worth per job. The sub-blocks the
+    // synthesiser splits off at note events are usually far shorter and stay serial.
+    const int minParallelVoiceSamples = 8192;
+    const int minSamplesPerJob = 1024;
+}
+
+struct HedriteSynthesiser::SharedVoicePool {
+    juce::ThreadPool threads{ juce::SystemStats::getNumCpus() };
+};
+
+HedriteSynthesiser::HedriteSynthesiser() {
+    // Sample accurate note timing makes the output independent of the host's block size,
+    // so a bounce at any block size matches what was heard during playback
+    setMinimumRenderingSubdivisionSize(1, true);
+}
+
+HedriteSynthesiser::~HedriteSynthesiser() {
+    release();
+}
+
+void HedriteSynthesiser::prepare(double sampleRate, int maximumBlockSize, int numChannels) {
+    setCurrentPlaybackSampleRate(sampleRate);
+    release();
+
+    // Everything is in place even for real-time use, since hosts can switch to offline without preparing again
+    maxBlockSize = maximumBlockSize;
+    pool = std::make_unique<juce::SharedResourcePointer<SharedVoicePool>>();
+
+    for (int i = 0; i < getNumVoices(); i++) {
+        auto job = std::make_unique<VoiceJob>();
+        job->scratch.setSize(numChannels, maximumBlockSize);
+        jobs.push_back(std::move(job));
+    }
+    activeJobs.reserve(jobs.size());
+}
+
+void HedriteSynthesiser::release() {
+    pool.reset();
+    jobs.clear();
+    activeJobs.clear();
+    maxBlockSize = 0;
+}
+
+void HedriteSynthesiser::setNonRealtime(bool isNonRealtime) {
+    renderInParallel.store(isNonRealtime, std::memory_order_relaxed);
+}
+
+void HedriteSynthesiser::renderVoices(juce::AudioBuffer<float>& outputAudio, int startSample, int numSamples) {
+    if (!renderInParallel.load(std::memory_order_relaxed) || pool == nullptr || numSamples > maxBlockSize
+        || (int)jobs.size() != getNumVoices() || outputAudio.getNumChannels() != jobs.front()->scratch.getNumChannels()) {
+        juce::Synthesiser::renderVoices(outputAudio, startSample, numSamples);
+        return;
+    }
+
+    activeJobs.clear();
+    for (int i = 0; i < getNumVoices(); i++) {
+        auto* voice = getVoice(i);
+        if (voice->isVoiceActive()) {
+            auto* job = jobs[(size_t)i].get();
+            job->voice = voice;
+            job->numSamples = numSamples;
+            activeJobs.push_back(job);
+        }
+    }
+
+    // Not worth waking the pool for a little work; the result is the same either way
+    auto numActiveVoices = (int)activeJobs.size();
+    if (numActiveVoices < 2 || numSamples < minSamplesPerJob || numActiveVoices * numSamples < minParallelVoiceSamples) {
+        juce::Synthesiser::renderVoices(outputAudio, startSample, numSamples);
+        return;
+    }
+
+    auto& threads = (*pool)->threads;
+    for (size_t j = 1; j < activeJobs.size(); j++) {
+        threads.addJob(activeJobs[j], false);
+    }
+    activeJobs.front()->runJob();
+    for (size_t j = 1; j < activeJobs.size(); j++) {
+        threads.waitForJobToFinish(activeJobs[j], -1);
+    }
+
+    for (auto* job : activeJobs) {
+        for (int channel = 0; channel < outputAudio.getNumChannels(); channel++) {
+            outputAudio.addFrom(channel, startSample, job->scratch, channel, 0, numSamples);
+        }
+    }
+}
+
+juce::SynthesiserVoice* HedriteSynthesiser::findVoiceToSteal(juce::SynthesiserSound* soundToPlay, int midiChannel, int midiNoteNumber) const {
+    HEDRITE_RT_LOCKING_CALL();
+    return juce::Synthesiser::findVoiceToSteal(soundToPlay, midiChannel, midiNoteNumber);
+}
+
+/*
+*   VoiceJob
+*/
+HedriteSynthesiser::VoiceJob::VoiceJob() : juce::ThreadPoolJob("Voice") {
+}
+
+juce::ThreadPoolJob::JobStatus HedriteSynthesiser::VoiceJob::runJob() {
+    // Pool threads don't inherit the audio thread's denormal mode, and flushing differently would change the sums
+    juce::ScopedNoDenormals noDenormals;
+    scratch.clear(0, numSamples);
+    voice->renderNextBlock(scratch, 0, numSamples);
+    return jobHasFinished;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+#include <vector>
+
+// Synthesiser that, when the host renders offline, spreads its voices over every core. Each voice renders into its own
+// scratch buffer and the buffers are summed in voice order, the same order the voices add themselves to the output in
+// real time, so the voice mix is bit-identical either way. Blocks with too little work to pay for handing it to other
+// threads are rendered serially.
+//
+// The plug-in's output as a whole only matches to the bit when nothing was dropped in real time. There, a late
+// convolution tail block plays silent and voices are silent until the wavetable is built; offline, both are waited for.
+class HedriteSynthesiser : public juce::Synthesiser {
+public:
+	HedriteSynthesiser();
+	~HedriteSynthesiser() override;
+
+	// Allocates scratch buffers and joins the worker pool. Call from prepareToPlay.
+	void prepare(double sampleRate, int maximumBlockSize, int numChannels);
+	void release();
+
+	// Voices only go to the pool while this is set. Safe to call at any time; it applies from the next block.
+	void setNonRealtime(bool isNonRealtime);
+
+protected:
+	void renderVoices(juce::AudioBuffer<float>& outputAudio, int startSample, int numSamples) override;
+
+	// Only reports to the real-time guard; juce::Synthesiser takes a lock of its own to pick the voice to steal
+	juce::SynthesiserVoice* findVoiceToSteal(juce::SynthesiserSound* soundToPlay, int midiChannel, int midiNoteNumber) const override;
+
+private:
+	struct VoiceJob : public juce::ThreadPoolJob {
+		VoiceJob();
+		JobStatus runJob() override;
+
+		juce::SynthesiserVoice* voice = nullptr;
+		juce::AudioBuffer<float> scratch;
+		int numSamples = 0;
+	};
+
+	// Shared by every instance in the process, so bouncing several at once doesn't start a thread per core for each
+	struct SharedVoicePool;
+	std::unique_ptr<juce::SharedResourcePointer<SharedVoicePool>> pool;
+	std::vector<std::unique_ptr<VoiceJob>> jobs;
+	std::vector<VoiceJob*> activeJobs;
+	int maxBlockSize = 0;
+	std::atomic<bool> renderInParallel{ false };
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(HedriteSynthesiser)
+};
@@ -0,0 +1,234 @@
+#include "Mesh.h"
+#include <thread>
+#include <unordered_map>
+
+namespace {
+    const juce::uint32 invalidIndex = 0xffffffff;
+
+    // Below this many items per thread the cost of starting threads outweighs the work
+    const int minItemsPerThread = 4096;
+
+    // Corner normals closer than this share an output vertex
+    const float sameNormalDot = 0.9999f;
+
+    template <typename Function>
+    void parallelForRanges(int numItems, Function&& function) {
+        auto numThreads = juce::jlimit(1, juce::jmax(1, juce::SystemStats::getNumCpus()), numItems / minItemsPerThread);
+
+        if (numThreads <= 1) {
+            function(0, numItems);
+            return;
+        }
+
+        auto itemsPerThread = (numItems + numThreads - 1) / numThreads;
+        std::vector<std::thread> threads;
+
+        for (int t = 1; t < numThreads; t++) {
+            auto begin = t * itemsPerThread;
+            auto end = juce::jmin(numItems, begin + itemsPerThread);
+            threads.emplace_back([&function, begin, end] { function(begin, end); });
+        }
+
+        function(0, itemsPerThread);
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    juce::int64 cellKey(int x, int y, int z) {
+        // 21 bits per axis is plenty for the cell coordinates of any mesh we'd draw
+        return ((juce::int64)(x & 0x1fffff) << 42) | ((juce::int64)(y & 0x1fffff) << 21) | (juce::int64)(z & 0x1fffff);
+    }
+
+    // Merges points within tolerance of each other using a uniform grid. Returns the welded index of every input point.
+    std::vector<juce::uint32> weld(const std::vector<Vector3D<float>>& points, float tolerance, std::vector<Vector3D<float>>& weldedPoints) {
+        std::vector<juce::uint32> remap(points.size());
+        auto cellSize = juce::jmax(tolerance, 1.0e-6f);
+        auto toleranceSquared = tolerance * tolerance;
+        std::unordered_map<juce::int64, std::vector<juce::uint32>> grid;
+
+        for (size_t i = 0; i < points.size(); i++) {
+            auto& p = points[i];
+            int cx = (int)std::floor(p.x / cellSize);
+            int cy = (int)std::floor(p.y / cellSize);
+            int cz = (int)std::floor(p.z / cellSize);
+
+            auto match = invalidIndex;
+            for (int dx = -1; dx <= 1 && match == invalidIndex; dx++) {
+                for (int dy = -1; dy <= 1 && match == invalidIndex; dy++) {
+                    for (int dz = -1; dz <= 1 && match == invalidIndex; dz++) {
+                        auto cell = grid.find(cellKey(cx + dx, cy + dy, cz + dz));
+                        if (cell == grid.end())
+                            continue;
+
+                        for (auto candidate : cell->second) {
+                            auto d = weldedPoints[candidate] - p;
+                            if (d * d <= toleranceSquared) {
+                                match = candidate;
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+
+            if (match == invalidIndex) {
+                match = (juce::uint32)weldedPoints.size();
+                weldedPoints.push_back(p);
+                grid[cellKey(cx, cy, cz)].push_back(match);
+            }
+            remap[i] = match;
+        }
+        return remap;
+    }
+}
+
+Mesh Mesh::process(const std::vector<Vector3D<float>>& points, const std::vector<juce::uint32>& triangleIndices,
+    float weldTolerance, float creaseAngleDegrees) {
+    jassert(triangleIndices.size() % 3 == 0);
+
+    // Weld, then drop triangles that collapsed to a line or a point
+    std::vector<Vector3D<float>> weldedPoints;
+    auto remap = weld(points, weldTolerance, weldedPoints);
+
+    std::vector<juce::uint32> faces;
+    faces.reserve(triangleIndices.size());
+    for (size_t i = 0; i + 2 < triangleIndices.size(); i += 3) {
+        auto a = remap[triangleIndices[i]], b = remap[triangleIndices[i + 1]], c = remap[triangleIndices[i + 2]];
+        if (a != b && b != c && c != a) {
+            faces.insert(faces.end(), { a, b, c });
+        }
+    }
+
+    auto numFaces = (int)(faces.size() / 3);
+    auto numCorners = numFaces * 3;
+    auto numWeldedVertices = (int)weldedPoints.size();
+
+    // Half-edges: half-edge h starts at corner h, runs to the next corner of the same face, and twin is the opposite half-edge
+    std::vector<juce::uint32> twins(numCorners, invalidIndex);
+    {
+        std::unordered_map<juce::uint64, juce::uint32> halfEdgeLookup;
+        halfEdgeLookup.reserve(numCorners);
+        for (int h = 0; h < numCorners; h++) {
+            auto from = faces[h], to = faces[h - h % 3 + (h + 1) % 3];
+            halfEdgeLookup.emplace(((juce::uint64)from << 32) | to, (juce::uint32)h);
+        }
+        for (int h = 0; h < numCorners; h++) {
+            auto from = faces[h], to = faces[h - h % 3 + (h + 1) % 3];
+            auto twin = halfEdgeLookup.find(((juce::uint64)to << 32) | from);
+            if (twin != halfEdgeLookup.end()) {
+                twins[h] = twin->second;
+            }
+        }
+    }
+
+    // Faces around each vertex, stored contiguously per vertex
+    std::vector<int> vertexFaceOffsets(numWeldedVertices + 1, 0);
+    std::vector<int> vertexFaces(numCorners);
+    for (auto v : faces) {
+        vertexFaceOffsets[v + 1]++;
+    }
+    for (int v = 0; v < numWeldedVertices; v++) {
+        vertexFaceOffsets[v + 1] += vertexFaceOffsets[v];
+    }
+    {
+        auto fill = vertexFaceOffsets;
+        for (int c = 0; c < numCorners; c++) {
+            vertexFaces[fill[faces[c]]++] = c / 3;
+        }
+    }
+
+    // Area weighted and unit face normals
+    std::vector<Vector3D<float>> faceNormals(numFaces), unitFaceNormals(numFaces);
+    parallelForRanges(numFaces, [&](int begin, int end) {
+        for (int f = begin; f < end; f++) {
+            auto& a = weldedPoints[faces[f * 3]];
+            auto& b = weldedPoints[faces[f * 3 + 1]];
+            auto& c = weldedPoints[faces[f * 3 + 2]];
+            faceNormals[f] = (b - a) ^ (c - a);
+
+            auto length = faceNormals[f].length();
+            unitFaceNormals[f] = length > 0.0f ? faceNormals[f] / length : faceNormals[f];
+        }
+    });
+
+    // Each corner averages the faces around its vertex that are within the crease angle of its own face
+    auto cosCreaseAngle = std::cos(juce::degreesToRadians(juce::jlimit(0.0f, 180.0f, creaseAngleDegrees)));
+    std::vector<Vector3D<float>> cornerNormals(numCorners);
+    parallelForRanges(numFaces, [&](int begin, int end) {
+        for (int f = begin; f < end; f++) {
+            for (int k = 0; k < 3; k++) {
+                auto v = faces[f * 3 + k];
+                Vector3D<float> sum;
+                for (int i = vertexFaceOffsets[v]; i < vertexFaceOffsets[v + 1]; i++) {
+                    auto g = vertexFaces[i];
+                    if (g == f || unitFaceNormals[f] * unitFaceNormals[g] >= cosCreaseAngle) {
+                        sum += faceNormals[g];
+                    }
+                }
+
+                auto length = sum.length();
+                cornerNormals[f * 3 + k] = length > 0.0f ? sum / length : unitFaceNormals[f];
+            }
+        }
+    });
+
+    // Split welded vertices only where their corners disagree on the normal
+    Mesh mesh;
+    mesh.triangles.resize(numCorners);
+    std::vector<juce::uint32> firstOutputVertex(numWeldedVertices, invalidIndex);
+    std::vector<juce::uint32> nextOutputVertex;
+
+    for (int c = 0; c < numCorners; c++) {
+        auto v = faces[c];
+        auto& normal = cornerNormals[c];
+
+        auto output = firstOutputVertex[v];
+        while (output != invalidIndex && mesh.normals[output] * normal < sameNormalDot) {
+            output = nextOutputVertex[output];
+        }
+
+        if (output == invalidIndex) {
+            output = (juce::uint32)mesh.positions.size();
+            mesh.positions.push_back(weldedPoints[v]);
+            mesh.normals.push_back(normal);
+            nextOutputVertex.push_back(firstOutputVertex[v]);
+            firstOutputVertex[v] = output;
+        }
+        mesh.triangles[c] = output;
+    }
+
+    // Every edge once: boundary half-edges, and the lower numbered half of each twin pair
+    for (int h = 0; h < numCorners; h++) {
+        if (twins[h] == invalidIndex || (juce::uint32)h < twins[h]) {
+            mesh.edges.push_back(mesh.triangles[h]);
+            mesh.edges.push_back(mesh.triangles[h - h % 3 + (h + 1) % 3]);
+        }
+    }
+
+    return mesh;
+}
+
+int Mesh::getNumVertices() const {
+    return (int)positions.size();
+}
+
+int Mesh::getNumTriangles() const {
+    return (int)(triangles.size() / 3);
+}
+
+std::vector<Vector3D<float>> Mesh::getTetrahedronPoints() {
+    const float invsqrt2 = 1.0f / std::sqrt(2.0f);
+
+    return {
+       Vector3D<float>(1.0f, 0.0f, invsqrt2),
+       Vector3D<float>(-1.0f, 0.0f, invsqrt2),
+       Vector3D<float>(0.0f, -1.0f, -invsqrt2),
+       Vector3D<float>(0.0f, 1.0f, -invsqrt2),
+    };
+}
+
+int Mesh::getNumEdges() const {
+    return (int)(edges.size() / 2);
+}
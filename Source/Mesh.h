@@ -0,0 +1,25 @@
+#pragma once
+#include <JuceHeader.h>
+#include <vector>
+
+// Indexed triangle mesh ready to upload: vertices are shared between triangles wherever position and normal agree,
+// and edges holds each unique edge once as a pair of vertex indices for drawing wireframes with GL_LINES.
+class Mesh {
+public:
+	std::vector<Vector3D<float>> positions;
+	std::vector<Vector3D<float>> normals;
+	std::vector<juce::uint32> triangles;
+	std::vector<juce::uint32> edges;
+
+	// Builds a mesh from triangle soup. Points closer than weldTolerance are merged first. Normals of faces meeting at less
+	// than creaseAngleDegrees are averaged, so 0 gives flat shading and 180 fully smooth shading.
+	static Mesh process(const std::vector<Vector3D<float>>& points, const std::vector<juce::uint32>& triangleIndices,
+		float weldTolerance, float creaseAngleDegrees);
+
+	// Corners of the tetrahedron Hedrite draws. Kept here, away from the GL code, so the audio side can use the same shape.
+	static std::vector<Vector3D<float>> getTetrahedronPoints();
+
+	int getNumVertices() const;
+	int getNumTriangles() const;
+	int getNumEdges() const;
+};
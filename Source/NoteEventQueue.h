@@ -0,0 +1,50 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Single producer, single consumer queue that hands note-ons from the audio thread to the visuals.
+// Never blocks or allocates; events are dropped when the consumer falls behind or when nothing is reading.
+class NoteEventQueue {
+public:
+	struct NoteEvent {
+		int noteNumber;
+		float velocity;
+	};
+
+	static constexpr int capacity = 256;
+
+	// Without a consumer every push is dropped, so an editor opened later doesn't get a backlog of old notes
+	bool push(const NoteEvent& event) {
+		if (!consumerAttached.load(std::memory_order_acquire))
+			return false;
+
+		auto scope = fifo.write(1);
+		if (scope.blockSize1 > 0) {
+			events[scope.startIndex1] = event;
+			return true;
+		}
+		return false;
+	}
+
+	bool pop(NoteEvent& event) {
+		auto scope = fifo.read(1);
+		if (scope.blockSize1 > 0) {
+			event = events[scope.startIndex1];
+			return true;
+		}
+		return false;
+	}
+
+	// Attaching drops anything left over from an earlier consumer. Call from the consumer's side, while it isn't popping.
+	void setConsumerAttached(bool isAttached) {
+		if (isAttached) {
+			NoteEvent staleEvent;
+			while (pop(staleEvent)) {}
+		}
+		consumerAttached.store(isAttached, std::memory_order_release);
+	}
+
+private:
+	std::atomic<bool> consumerAttached{ false };
+	juce::AbstractFifo fifo{ capacity };
+	NoteEvent events[capacity];
+};
@@ -1,22 +1,89 @@
 #include "OpenGLWindow.h"
+#include "SoftwareRenderer.h"
 
 OpenGLWindow::OpenGLWindow() {
     setSize(700, 700);
     camera.setViewport(getLocalBounds());
+    lastViewMatrix = getViewMatrix();
+
+    // Frames are paced by the timer instead of rendering as fast as the context allows
+    openGLContext.setContinuousRepainting(false);
+    setFrameRates(foregroundFrameRate, backgroundFrameRate);
 }
 
 
 OpenGLWindow::~OpenGLWindow() {
+    stopTimer();
     shutdownOpenGL();
+    setNoteEventQueue(nullptr);
 }
 
 void OpenGLWindow::setInitializeCallback(void(*cb)()) {
     initializeCallback = cb;
 };
 
+void OpenGLWindow::setNoteEventQueue(NoteEventQueue* queue) {
+    // The processor only queues notes while a window is reading them
+    if (auto* previousQueue = noteEventQueue.exchange(nullptr))
+        previousQueue->setConsumerAttached(false);
+
+    if (queue != nullptr)
+        queue->setConsumerAttached(true);
+
+    noteEventQueue = queue;
+}
+
+void OpenGLWindow::setShapes(std::vector<Shape> newShapes) {
+    const juce::ScopedLock lock(shapeLock);
+
+    // Buffers can only be deleted on the GL thread, so uploaded shapes wait there to be destroyed
+    for (auto& shape : shapes) {
+        if (!shape.vertexBuffers.isEmpty())
+            retiredShapes.push_back(std::move(shape));
+    }
+    shapes = std::move(newShapes);
+}
+
+void OpenGLWindow::setFrameRates(double foreground, double background) {
+    foregroundFrameRate = foreground;
+    backgroundFrameRate = background;
+    timerCallback();
+}
+
+void OpenGLWindow::timerCallback() {
+    // Background windows and software GL get the lower rate so visuals don't compete with the audio threads
+    auto frameRate = isInForeground() && !isSoftwareRenderer ? foregroundFrameRate : backgroundFrameRate;
+
+    if (frameRate != frameScheduler.getTargetFrameRate() || !isTimerRunning()) {
+        frameScheduler.setTargetFrameRate(frameRate);
+        startTimerHz(roundToInt(frameRate));
+    }
+
+    openGLContext.triggerRepaint();
+}
+
+bool OpenGLWindow::isInForeground() {
+    // A focused host can still have this editor hidden behind its other windows, so the window's own state counts too
+    auto* peer = getPeer();
+    return juce::Process::isForegroundProcess() && isShowing() && peer != nullptr && !peer->isMinimised()
+        && (peer->isFocused() || isMouseOverOrDragging(true));
+}
+
 
 void OpenGLWindow::initialise() {
+    detectSoftwareRenderer();
+    capabilities = GLCapabilities::detect();
+    DBG("--- " + capabilities.getDescription() + " ---");
     createShaders();
+    particleSystem.initialise(openGLContext, capabilities);
+
+    // The geometry is built without GL; all that's left here is handing it to the GPU
+    {
+        const juce::ScopedLock lock(shapeLock);
+        for (auto& shape : shapes) {
+            shape.upload();
+        }
+    }
     DBG("--- OpenGL initialized ---");
     if (initializeCallback) {
         initializeCallback();
@@ -25,8 +92,25 @@ void OpenGLWindow::initialise() {
 
 
 void OpenGLWindow::shutdown() {
+    using namespace ::juce::gl;
+
+#if ! JUCE_OPENGL_ES
+    if (gpuTimerQueries[0] != 0) {
+        glDeleteQueries(2, gpuTimerQueries);
+        gpuTimerQueries[0] = gpuTimerQueries[1] = 0;
+    }
+#endif
+    offscreenTarget.release();
+    particleSystem.shutdown();
     shader.reset();
-    shapes.clear();
+    {
+        // The shapes themselves stay, so they can be uploaded again if the context comes back
+        const juce::ScopedLock lock(shapeLock);
+        for (auto& shape : shapes) {
+            shape.releaseBuffers();
+        }
+        retiredShapes.clear();
+    }
     attributes.reset();
     uniforms.reset();
 }
@@ -36,33 +120,94 @@ void OpenGLWindow::resized() {
 }
 
 void OpenGLWindow::mouseDown(const MouseEvent& e) {
+    if (e.mods.isPopupMenu()) {
+        showContextMenu();
+        return;
+    }
     camera.mouseDown(e.getPosition());
 }
 
 void OpenGLWindow::mouseDrag(const MouseEvent& e) {
+    if (e.mods.isPopupMenu())
+        return;
     camera.mouseDrag(e.getPosition());
 }
 
+void OpenGLWindow::showContextMenu() {
+    juce::PopupMenu menu;
+    menu.addItem("Save snapshot...", [this] { saveSnapshot(); });
+    menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(this));
+}
+
+void OpenGLWindow::saveSnapshot() {
+    snapshotChooser = std::make_unique<juce::FileChooser>("Save snapshot",
+        juce::File::getSpecialLocation(juce::File::userPicturesDirectory).getChildFile("Hedrite.png"), "*.png");
+
+    auto flags = juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::canSelectFiles
+        | juce::FileBrowserComponent::warnAboutOverwriting;
+
+    // Rendered on the CPU, so this works the same whether or not the GL context is up
+    snapshotChooser->launchAsync(flags, [this](const juce::FileChooser& chooser) {
+        auto file = chooser.getResult();
+        if (file == juce::File())
+            return;
+
+        auto scale = juce::Component::getApproximateScaleFactorForComponent(this);
+        auto image = renderSnapshot(roundToInt(scale * (float)getWidth()), roundToInt(scale * (float)getHeight()));
+
+        file.deleteFile();
+        juce::FileOutputStream stream(file);
+        juce::PNGImageFormat png;
+        if (!stream.openedOk() || !png.writeImageToStream(image, stream)) {
+            DBG("--- Couldn't write snapshot to " + file.getFullPathName() + " ---");
+        }
+    });
+}
+
 void OpenGLWindow::mouseWheelMove(const MouseEvent& e, const MouseWheelDetails& w) {
     cameraDistanceNext = cameraDistanceNext * (1-w.deltaY*scrollSpeedFactor);
 }
 
-auto newTime = std::chrono::high_resolution_clock::now();
-auto oldTime = std::chrono::high_resolution_clock::now();
-
 void OpenGLWindow::render(){
-    newTime = std::chrono::high_resolution_clock::now();
-    double dt = std::chrono::duration<double, std::milli>(newTime - oldTime).count()/1000;
-    oldTime = newTime;
+    frameScheduler.beginFrame();
+    double dt = frameScheduler.getDeltaTime();
     //update
     cameraDistance += 15*dt*((double)cameraDistanceNext - cameraDistance);
 
+    if (auto* queue = noteEventQueue.load()) {
+        NoteEventQueue::NoteEvent noteEvent;
+        while (queue->pop(noteEvent)) {
+            particleSystem.spawnBurst(noteEvent.noteNumber, noteEvent.velocity);
+        }
+    }
+    particleSystem.update((float)dt);
+
     //render
     using namespace ::juce::gl;
 
     jassert(juce::OpenGLHelpers::isContextActive());
 
     auto desktopScale = (float)openGLContext.getRenderingScale();
+    auto fullWidth = roundToInt(desktopScale * (float)getWidth());
+    auto fullHeight = roundToInt(desktopScale * (float)getHeight());
+
+#if JUCE_OPENGL_ES
+    auto renderWidth = fullWidth;
+    auto renderHeight = fullHeight;
+#else
+    auto renderScale = capabilities.canRenderOffscreen ? frameScheduler.getRenderScale() : 1.0f;
+    auto renderWidth = jmax(1, roundToInt(renderScale * (float)fullWidth));
+    auto renderHeight = jmax(1, roundToInt(renderScale * (float)fullHeight));
+#endif
+    bool renderOffscreen = renderWidth != fullWidth || renderHeight != fullHeight;
+
+    beginGpuTimer();
+
+    if (renderOffscreen) {
+        offscreenTarget.resize(renderWidth, renderHeight);
+        glBindFramebuffer(GL_FRAMEBUFFER, offscreenTarget.frameBuffer);
+    }
+
     juce::OpenGLHelpers::clear(Colour());
 
     glEnable(GL_BLEND);
@@ -71,41 +216,128 @@ void OpenGLWindow::render(){
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glPolygonOffset(0.1,1);
 
-    glViewport(0, 0, roundToInt(desktopScale * (float)getWidth()), roundToInt(desktopScale * (float)getHeight()));
+    glViewport(0, 0, renderWidth, renderHeight);
 
     shader->use();
 
     if (uniforms->projectionMatrix.get() != nullptr)
         uniforms->projectionMatrix->setMatrix4(getProjectionMatrix().mat, 1, false);
 
+    auto viewMatrix = getViewMatrix();
     if (uniforms->viewMatrix.get() != nullptr)
-        uniforms->viewMatrix->setMatrix4(getViewMatrix().mat, 1, false);
+        uniforms->viewMatrix->setMatrix4(viewMatrix.mat, 1, false);
 
+    // Normals are in model space, so rotate the light by the inverse of the view rotation to keep it fixed relative to the camera
+    Vector3D<float> lightPos = applyDirectionMatrix(transposeMatrix(viewMatrix), getLightPosition());
     if (uniforms->lightPosition.get() != nullptr) {
-        Vector3D<float> lightPos = (Vector3D<float>)applyTransformationMatrix(getViewMatrix(), getLightPosition());
         uniforms->lightPosition->set(lightPos.x, lightPos.y, lightPos.z, 1.0f);
     }
     
     uniforms->hasWireframe->set(0);
     uniforms->wireframeColour->set(0,0,0,1);
 
-    glPolygonMode(GL_FRONT, GL_FILL);
-    for (auto& shape : shapes) {
-        shape.draw(*attributes);
-    }
+    {
+        const juce::ScopedLock lock(shapeLock);
+        retiredShapes.clear();
+        lastViewMatrix = viewMatrix;
+
+        glPolygonMode(GL_FRONT, GL_FILL);
+        for (auto& shape : shapes) {
+            shape.draw(*attributes);
+        }
 
 
-    glPolygonMode(GL_FRONT, GL_LINE);
-    for (auto& shape : shapes) {
-        uniforms->hasWireframe->set(shape.hasWireframe? 1: 0);
-        uniforms->wireframeColour->set(shape.wireframeColour.getFloatRed(), shape.wireframeColour.getFloatGreen(), shape.wireframeColour.getFloatBlue(), shape.wireframeColour.getFloatAlpha());
-        shape.draw(*attributes);
+        glPolygonMode(GL_FRONT, GL_LINE);
+        for (auto& shape : shapes) {
+            uniforms->hasWireframe->set(shape.hasWireframe? 1: 0);
+            uniforms->wireframeColour->set(shape.wireframeColour.getFloatRed(), shape.wireframeColour.getFloatGreen(), shape.wireframeColour.getFloatBlue(), shape.wireframeColour.getFloatAlpha());
+            shape.drawWireframe(*attributes);
+        }
     }
 
+    glPolygonMode(GL_FRONT, GL_FILL);
+    particleSystem.draw(getProjectionMatrix(), viewMatrix, lightPos);
+
     // Reset the element buffers so child Components draw correctly
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
- 
+
+#if ! JUCE_OPENGL_ES
+    if (renderOffscreen) {
+        // Upscale the reduced resolution frame into the context's own framebuffer
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, offscreenTarget.frameBuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, openGLContext.getFrameBufferID());
+        glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, fullWidth, fullHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        glBindFramebuffer(GL_FRAMEBUFFER, openGLContext.getFrameBufferID());
+    }
+#endif
+
+    frameScheduler.endFrame(endGpuTimer());
+}
+
+void OpenGLWindow::detectSoftwareRenderer() {
+    using namespace ::juce::gl;
+
+    auto* rendererName = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+    juce::String renderer(rendererName != nullptr ? rendererName : "");
+    DBG("--- OpenGL renderer: " + renderer + " ---");
+
+    isSoftwareRenderer = renderer.containsIgnoreCase("llvmpipe")
+        || renderer.containsIgnoreCase("softpipe")
+        || renderer.containsIgnoreCase("software")
+        || renderer.containsIgnoreCase("GDI Generic");
+
+    // Software GL is fill rate bound, so allow it to drop much further before giving up on frames
+    if (isSoftwareRenderer) {
+        frameScheduler.setRenderScaleLimits(0.25f, 0.5f);
+    }
+}
+
+void OpenGLWindow::beginGpuTimer() {
+#if ! JUCE_OPENGL_ES
+    using namespace ::juce::gl;
+
+    if (!capabilities.hasTimerQueries)
+        return;
+
+    if (gpuTimerQueries[0] == 0) {
+        glGenQueries(2, gpuTimerQueries);
+    }
+
+    // Skip timing this frame rather than reuse a query whose result hasn't been read yet
+    if (!gpuTimerQueryPending[gpuTimerQueryIndex]) {
+        glBeginQuery(GL_TIME_ELAPSED, gpuTimerQueries[gpuTimerQueryIndex]);
+    }
+#endif
+}
+
+double OpenGLWindow::endGpuTimer() {
+#if ! JUCE_OPENGL_ES
+    using namespace ::juce::gl;
+
+    if (!capabilities.hasTimerQueries)
+        return -1.0;
+
+    if (!gpuTimerQueryPending[gpuTimerQueryIndex]) {
+        glEndQuery(GL_TIME_ELAPSED);
+        gpuTimerQueryPending[gpuTimerQueryIndex] = true;
+    }
+
+    // Read back the other query, which was issued a frame ago, only if it's ready so we never stall the pipeline
+    gpuTimerQueryIndex = 1 - gpuTimerQueryIndex;
+    if (gpuTimerQueryPending[gpuTimerQueryIndex]) {
+        GLint available = 0;
+        glGetQueryObjectiv(gpuTimerQueries[gpuTimerQueryIndex], GL_QUERY_RESULT_AVAILABLE, &available);
+
+        if (available != 0) {
+            GLuint64 elapsedNanoseconds = 0;
+            glGetQueryObjectui64v(gpuTimerQueries[gpuTimerQueryIndex], GL_QUERY_RESULT, &elapsedNanoseconds);
+            gpuTimerQueryPending[gpuTimerQueryIndex] = false;
+            return (double)elapsedNanoseconds / 1.0e6;
+        }
+    }
+#endif
+    return -1.0;
 }
 
 
@@ -193,12 +425,55 @@ juce::OpenGLShaderProgram::Uniform* OpenGLWindow::Uniforms::createUniform(juce::
 *   Shape
 */
 OpenGLWindow::Shape::Shape(int numIndices, float vertexPositions[], float vertexNormals[], juce::uint32 indices[], juce::Colour colour, bool hasWireframe, juce::Colour wireframeColour): hasWireframe(hasWireframe), wireframeColour(wireframeColour) {
-    vertexBuffers.add(new VertexBuffer(numIndices, vertexPositions, vertexNormals, indices, colour));
+    auto scale = 1.0f;
+
+    for (int v = 0; v < numIndices; v++) {
+        vertices.add({ { scale * vertexPositions[v * 3], scale * vertexPositions[v * 3 + 1], scale * vertexPositions[v * 3 + 2], },
+                { scale * vertexNormals[v * 3], scale * vertexNormals[v * 3 + 1], scale * vertexNormals[v * 3 + 2], },
+                { colour.getFloatRed(), colour.getFloatGreen(), colour.getFloatBlue(), colour.getFloatAlpha() }, });
+    };
+    this->indices.assign(indices, indices + numIndices);
+}
+
+OpenGLWindow::Shape::Shape(const Mesh& mesh, juce::Colour colour, bool hasWireframe, juce::Colour wireframeColour) : hasWireframe(hasWireframe), wireframeColour(wireframeColour) {
+    vertices.ensureStorageAllocated(mesh.getNumVertices());
+    for (int v = 0; v < mesh.getNumVertices(); v++) {
+        auto& position = mesh.positions[v];
+        auto& normal = mesh.normals[v];
+        vertices.add({ { position.x, position.y, position.z },
+                { normal.x, normal.y, normal.z },
+                { colour.getFloatRed(), colour.getFloatGreen(), colour.getFloatBlue(), colour.getFloatAlpha() }, });
+    }
+    indices = mesh.triangles;
+    edges = mesh.edges;
+}
+
+OpenGLWindow::Shape OpenGLWindow::Shape::copyGeometry() const {
+    Shape copy;
+    copy.vertices = vertices;
+    copy.indices = indices;
+    copy.edges = edges;
+    copy.hasWireframe = hasWireframe;
+    copy.wireframeColour = wireframeColour;
+    return copy;
+}
+
+void OpenGLWindow::Shape::upload() {
+    // Buffers are created on first draw so shapes can be built, and software rendered, without a GL context
+    if (vertexBuffers.isEmpty()) {
+        vertexBuffers.add(new VertexBuffer(vertices, indices, edges));
+    }
+}
+
+void OpenGLWindow::Shape::releaseBuffers() {
+    vertexBuffers.clear();
 }
 
 void OpenGLWindow::Shape::draw(Attributes& glAttributes) {
     using namespace ::juce::gl;
 
+    upload();
+
     for (auto* vertexBuffer : vertexBuffers) {
         vertexBuffer->bind();
 
@@ -208,30 +483,49 @@ void OpenGLWindow::Shape::draw(Attributes& glAttributes) {
     }
 }
 
-OpenGLWindow::Shape::VertexBuffer::VertexBuffer(int nIndices, float positions[], float normals[], juce::uint32 indices[], juce::Colour colour): numIndices(nIndices) {
+void OpenGLWindow::Shape::drawWireframe(Attributes& glAttributes) {
     using namespace ::juce::gl;
 
-    glGenBuffers(1, &vertexBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    upload();
 
-    auto scale = 1.0f;
+    for (auto* vertexBuffer : vertexBuffers) {
+        // Buffers with extracted edges draw each edge once as a line, the rest fall back to the polygon mode
+        if (vertexBuffer->edgeBuffer != 0) {
+            vertexBuffer->bindEdges();
 
-    juce::Array<Vertex> vertices;
-    for (int v = 0; v < numIndices; v++) {
-        vertices.add({ { scale * positions[v * 3], scale * positions[v * 3 + 1], scale * positions[v * 3 + 2], },
-                { scale * normals[v * 3], scale * normals[v * 3 + 1], scale * normals[v * 3 + 2], },
-                { colour.getFloatRed(), colour.getFloatGreen(), colour.getFloatBlue(), colour.getFloatAlpha() }, });
-    };
+            glAttributes.enable();
+            glDrawElements(GL_LINES, vertexBuffer->numEdgeIndices, GL_UNSIGNED_INT, nullptr);
+            glAttributes.disable();
+        }
+        else {
+            vertexBuffer->bind();
 
+            glAttributes.enable();
+            glDrawElements(GL_TRIANGLES, vertexBuffer->numIndices, GL_UNSIGNED_INT, nullptr);
+            glAttributes.disable();
+        }
+    }
+}
 
+OpenGLWindow::Shape::VertexBuffer::VertexBuffer(const juce::Array<Vertex>& vertices, const std::vector<juce::uint32>& indices, const std::vector<juce::uint32>& edges)
+    : numIndices((int)indices.size()), numEdgeIndices((int)edges.size()) {
+    using namespace ::juce::gl;
 
+    glGenBuffers(1, &vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
     glBufferData(GL_ARRAY_BUFFER,
         static_cast<GLsizeiptr> (static_cast<size_t> (vertices.size()) * sizeof(Vertex)),
-        vertices.getRawDataPointer(), GL_STATIC_DRAW);
+        vertices.begin(), GL_STATIC_DRAW);
 
     glGenBuffers(1, &indexBuffer);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr> (static_cast<size_t> (numIndices) * sizeof(juce::uint32)), indices, GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr> (indices.size() * sizeof(juce::uint32)), indices.data(), GL_STATIC_DRAW);
+
+    if (numEdgeIndices > 0) {
+        glGenBuffers(1, &edgeBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, edgeBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr> (edges.size() * sizeof(juce::uint32)), edges.data(), GL_STATIC_DRAW);
+    }
 }
 
 OpenGLWindow::Shape::VertexBuffer::~VertexBuffer() {
@@ -239,6 +533,8 @@ OpenGLWindow::Shape::VertexBuffer::~VertexBuffer() {
 
     glDeleteBuffers(1, &vertexBuffer);
     glDeleteBuffers(1, &indexBuffer);
+    if (edgeBuffer != 0)
+        glDeleteBuffers(1, &edgeBuffer);
 }
 
 void OpenGLWindow::Shape::VertexBuffer::bind() {
@@ -248,9 +544,63 @@ void OpenGLWindow::Shape::VertexBuffer::bind() {
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
 }
 
+void OpenGLWindow::Shape::VertexBuffer::bindEdges() {
+    using namespace ::juce::gl;
+
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, edgeBuffer);
+}
+
+/*
+*   OffscreenTarget
+*/
+void OpenGLWindow::OffscreenTarget::resize(int newWidth, int newHeight) {
+    using namespace ::juce::gl;
+
+    if (frameBuffer != 0 && newWidth == width && newHeight == height)
+        return;
+
+    if (frameBuffer == 0) {
+        glGenFramebuffers(1, &frameBuffer);
+        glGenRenderbuffers(1, &colourBuffer);
+        glGenRenderbuffers(1, &depthBuffer);
+    }
+
+    width = newWidth;
+    height = newHeight;
+
+    glBindRenderbuffer(GL_RENDERBUFFER, colourBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colourBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    jassert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+}
+
+void OpenGLWindow::OffscreenTarget::release() {
+    using namespace ::juce::gl;
+
+    if (frameBuffer == 0)
+        return;
+
+    glDeleteFramebuffers(1, &frameBuffer);
+    glDeleteRenderbuffers(1, &colourBuffer);
+    glDeleteRenderbuffers(1, &depthBuffer);
+    frameBuffer = colourBuffer = depthBuffer = 0;
+    width = height = 0;
+}
+
 Matrix3D<float> OpenGLWindow::getProjectionMatrix() const {
+    return getProjectionMatrix(getLocalBounds().toFloat().getAspectRatio(false));
+}
+
+Matrix3D<float> OpenGLWindow::getProjectionMatrix(float heightOverWidth) {
     auto w = .25f;
-    auto h = w * getLocalBounds().toFloat().getAspectRatio(false);
+    auto h = w * heightOverWidth;
 
     return Matrix3D<float>::fromFrustum(-w, w, -h, h, 1.0f, 200.0f);
 
@@ -266,13 +616,36 @@ Matrix3D<float> OpenGLWindow::getViewMatrix() const {
     return rotationMatrix * viewMatrix;
 }
 
-Vector3D<float> OpenGLWindow::getLightPosition() const {
+Vector3D<float> OpenGLWindow::getLightPosition() {
     Vector3D<float> lightPos(10.0f,10.0f,5.0f);
 
     return lightPos;
 }
 
 
+juce::Image OpenGLWindow::renderSnapshot(int width, int height) const {
+    // Only copying is done under the lock, so the GL thread isn't held up for the whole rasterisation
+    std::vector<Shape> snapshotShapes;
+    Matrix3D<float> viewMatrix;
+    {
+        const juce::ScopedLock lock(shapeLock);
+        snapshotShapes.reserve(shapes.size());
+        for (auto& shape : shapes) {
+            snapshotShapes.push_back(shape.copyGeometry());
+        }
+        viewMatrix = lastViewMatrix;
+    }
+    return renderSnapshot(snapshotShapes, viewMatrix, width, height);
+}
+
+juce::Image OpenGLWindow::renderSnapshot(const std::vector<Shape>& shapes, const Matrix3D<float>& viewMatrix, int width, int height) {
+    // Particles aren't included; the snapshot is of the instrument itself
+    SoftwareRenderer renderer;
+    Vector3D<float> lightPos = applyDirectionMatrix(transposeMatrix(viewMatrix), getLightPosition());
+
+    return renderer.render(shapes, getProjectionMatrix((float)height / (float)jmax(1, width)), viewMatrix, lightPos, width, height);
+}
+
 void OpenGLWindow::createShaders() {
     vertexShader = R"(
     attribute vec4 position;
@@ -290,7 +663,7 @@ void OpenGLWindow::createShaders() {
 
     void main()
     {
-        destinationColour = vec4( (hasWireframe > 0 ? wireframeColour.xyz : sourceColour.xyz)*min(1, .5+max(dot(normalize(normal), normalize(lightPosition)), 0.0)),1);
+        destinationColour = vec4( (hasWireframe > 0 ? wireframeColour.xyz : sourceColour.xyz)*min(1, .5+max(dot(normalize(normal.xyz), normalize(lightPosition.xyz)), 0.0)),1);
         gl_Position = projectionMatrix * viewMatrix *position ;
     })";
     fragmentShader =
@@ -330,23 +703,3 @@ void OpenGLWindow::createShaders() {
         statusText = newShader->getLastError();
     }
 };
-
-
-
-juce::Vector3D<float> applyTransformationMatrix(const juce::Matrix3D<float>& matrix, const juce::Vector3D<float>& vector) {
-    juce::Vector3D<float> result;
-    result.x = result.x = matrix.mat[4 * 0 + 0] * vector.x + matrix.mat[4 * 0 + 1] * vector.y + matrix.mat[4 * 0 + 2] * vector.z + matrix.mat[4 * 0 + 3];
-    result.y = result.y = matrix.mat[4 * 1 + 0] * vector.x + matrix.mat[4 * 1 + 1] * vector.y + matrix.mat[4 * 1 + 2] * vector.z + matrix.mat[4 * 1 + 3];
-    result.z = result.z = matrix.mat[4 * 2 + 0] * vector.x + matrix.mat[4 * 2 + 1] * vector.y + matrix.mat[4 * 2 + 2] * vector.z + matrix.mat[4 * 2 + 3];
-    return result;
-}
-
-juce::Matrix3D<float> transposeMatrix(const juce::Matrix3D<float>& matrix) {
-    juce::Matrix3D<float> result;
-    for (int i = 0; i < 4; i++) {
-        for (int j = 0; j < 4; j++) {
-            result.mat[4 * j + i] = matrix.mat[4 * j + i];
-        }
-    }
-    return result;
-}
\ No newline at end of file
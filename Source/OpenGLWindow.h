@@ -1,8 +1,14 @@
 #pragma once
 #include <JuceHeader.h>
 #include <iostream>
-
-class OpenGLWindow : public juce::OpenGLAppComponent {
+#include "FrameScheduler.h"
+#include "GLCapabilities.h"
+#include "NoteEventQueue.h"
+#include "ParticleSystem.h"
+#include "VectorMath.h"
+#include "Mesh.h"
+
+class OpenGLWindow : public juce::OpenGLAppComponent, private juce::Timer {
 public:
 	struct Vertex {
 		float position[3];
@@ -29,40 +35,90 @@ public:
 
     struct Shape {
         struct VertexBuffer {
-            GLuint vertexBuffer, indexBuffer;
-            int numIndices;
+            GLuint vertexBuffer, indexBuffer, edgeBuffer = 0;
+            int numIndices, numEdgeIndices = 0;
 
 			JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(VertexBuffer);
 
-			explicit VertexBuffer(int numIndices, float positions[], float normals[], juce::uint32 indices[], juce::Colour colour);
+			VertexBuffer(const juce::Array<Vertex>& vertices, const std::vector<juce::uint32>& indices, const std::vector<juce::uint32>& edges);
 
 			~VertexBuffer();
 
 			void bind();
+			void bindEdges();
         };
         juce::OwnedArray<VertexBuffer> vertexBuffers;
+
+		// CPU copy of the geometry, uploaded on first draw and also read by the software renderer
+		juce::Array<Vertex> vertices;
+		std::vector<juce::uint32> indices;
+		std::vector<juce::uint32> edges;
+
 		bool hasWireframe;
 		juce::Colour wireframeColour;
 
 		Shape(int numIndices, float vertexPositions[], float vertexNormals[], juce::uint32 indices[], juce::Colour colour, bool hasWireframe, juce::Colour wireframeColour);
+		Shape(const Mesh& mesh, juce::Colour colour, bool hasWireframe, juce::Colour wireframeColour);
 
+		// The CPU geometry without any GL buffers, so it can be drawn elsewhere once shapeLock is released
+		Shape copyGeometry() const;
+
+		void upload();
+		void releaseBuffers();
 		void draw(Attributes& glAttributes);
+		void drawWireframe(Attributes& glAttributes);
+
+	private:
+		Shape() = default;
     };
 
+	// Colour and depth renderbuffers that a reduced resolution frame is drawn into before being upscaled
+	struct OffscreenTarget {
+		GLuint frameBuffer = 0, colourBuffer = 0, depthBuffer = 0;
+		int width = 0, height = 0;
+
+		void resize(int newWidth, int newHeight);
+		void release();
+	};
+
 	juce::String vertexShader;
 	juce::String fragmentShader;
 
 	std::unique_ptr<juce::OpenGLShaderProgram> shader;
-	std::vector<Shape> shapes;
+
+	// Read by the GL thread every frame and by snapshots on the message thread; hold shapeLock to touch any of these.
+	// The camera distance is animated on the GL thread, so snapshots use the view it last drew rather than the camera.
+	std::vector<Shape> shapes, retiredShapes;
+	Matrix3D<float> lastViewMatrix;
+	juce::CriticalSection shapeLock;
 	std::unique_ptr<Attributes> attributes;
 	std::unique_ptr<Uniforms> uniforms;
 
 	Draggable3DOrientation camera;
-	float cameraDistanceNext = 10.0f;
-	float cameraDistance = 10.0f;
+	static constexpr float defaultCameraDistance = 10.0f;
+	float cameraDistanceNext = defaultCameraDistance;
+	float cameraDistance = defaultCameraDistance;
 
 	float scrollSpeedFactor = 0.5;
 
+	ParticleSystem particleSystem;
+	std::atomic<NoteEventQueue*> noteEventQueue{ nullptr };
+
+	FrameScheduler frameScheduler;
+	OffscreenTarget offscreenTarget;
+	double foregroundFrameRate = 60.0;
+	double backgroundFrameRate = 30.0;
+	std::atomic<bool> isSoftwareRenderer{ false };
+
+	// Checked once the context exists; without them frames aren't timed on the GPU or drawn at reduced resolution
+	GLCapabilities capabilities;
+
+#if ! JUCE_OPENGL_ES
+	GLuint gpuTimerQueries[2]{ 0, 0 };
+	bool gpuTimerQueryPending[2]{ false, false };
+	int gpuTimerQueryIndex = 0;
+#endif
+
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(OpenGLWindow)
 
 	void(*initializeCallback)();
@@ -71,6 +127,11 @@ public:
 	~OpenGLWindow() override;
 	void initialise() override;
 	void setInitializeCallback(void(*cb)());
+	void setFrameRates(double foreground, double background);
+	void setNoteEventQueue(NoteEventQueue* queue);
+
+	// Replaces the shapes drawn; safe to call with or without a GL context, which uploads them when it next draws
+	void setShapes(std::vector<Shape> newShapes);
 
 	void shutdown() override;
 	void render() override;
@@ -85,10 +146,25 @@ public:
 
 	void paint(juce::Graphics& g) override;
 
+	void timerCallback() override;
+
 	void createShaders();
+	void detectSoftwareRenderer();
+	bool isInForeground();
+	void beginGpuTimer();
+	double endGpuTimer();
 	Matrix3D<float> getViewMatrix() const;
-	Vector3D<float> getLightPosition() const;
+	static Vector3D<float> getLightPosition();
 	Matrix3D<float> getProjectionMatrix() const;
-};
-juce::Vector3D<float> applyTransformationMatrix(const juce::Matrix3D<float>& matrix, const juce::Vector3D<float>& vector);
-juce::Matrix3D<float> transposeMatrix(const juce::Matrix3D<float>& matrix);
\ No newline at end of file
+	static Matrix3D<float> getProjectionMatrix(float heightOverWidth);
+
+	// Draws the current view on the CPU, for when there is no usable OpenGL context
+	juce::Image renderSnapshot(int width, int height) const;
+
+	// Draws any shapes from the given view on the CPU, with no window or GL context needed
+	static juce::Image renderSnapshot(const std::vector<Shape>& shapes, const Matrix3D<float>& viewMatrix, int width, int height);
+
+	void showContextMenu();
+	void saveSnapshot();
+	std::unique_ptr<juce::FileChooser> snapshotChooser;
+};
\ No newline at end of file
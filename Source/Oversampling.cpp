@@ -0,0 +1,208 @@
+#include "Oversampling.h"
+
+namespace {
+    // The first stage has the whole band up to the host's Nyquist to protect; later ones only see what it let through
+    const int stageTapPairs[Oversampler::maxStages] = { 24, 12, 6 };
+
+    // Kaiser window shape for roughly 80 dB of stopband rejection
+    const double kaiserBeta = 8.0;
+
+    double besselI0(double x) {
+        double sum = 1.0, term = 1.0;
+        for (int k = 1; k < 32; k++) {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    // The non-zero even taps of a windowed sinc half-band lowpass; the odd ones are all zero apart from the 0.5 at the centre
+    std::vector<float> designHalfBandTaps(int numTapPairs) {
+        auto length = 4 * numTapPairs - 1;
+        auto centre = 2 * numTapPairs - 1;
+        std::vector<float> taps((size_t)(2 * numTapPairs));
+
+        double sum = 0.0;
+        for (int j = 0; j < 2 * numTapPairs; j++) {
+            auto offset = 0.5 * (double)(2 * j - centre);
+            auto sinc = std::sin(juce::MathConstants<double>::pi * offset) / (juce::MathConstants<double>::pi * offset);
+            auto position = 2.0 * (double)(2 * j) / (double)(length - 1) - 1.0;
+            auto window = besselI0(kaiserBeta * std::sqrt(1.0 - position * position)) / besselI0(kaiserBeta);
+
+            taps[(size_t)j] = (float)(0.5 * sinc * window);
+            sum += taps[(size_t)j];
+        }
+
+        // With the centre tap the filter then has exactly unity gain at DC
+        for (auto& tap : taps) {
+            tap = (float)(tap * 0.5 / sum);
+        }
+        return taps;
+    }
+
+    // output[n] = sum of taps[j] * input[n - j], where input points past numTaps - 1 samples of history.
+    // One pass per tap over contiguous samples, so the work is all vectorised multiply-adds.
+    void convolve(const float* input, const std::vector<float>& taps, float* output, int num) {
+        juce::FloatVectorOperations::clear(output, num);
+        for (size_t j = 0; j < taps.size(); j++) {
+            juce::FloatVectorOperations::addWithMultiply(output, input - j, taps[j], num);
+        }
+    }
+}
+
+/*
+*   HalfBandStage
+*/
+HalfBandStage::HalfBandStage(int numTapPairs) : numTapPairs(numTapPairs) {
+    downTaps = designHalfBandTaps(numTapPairs);
+
+    // Upsampling fills in a zero between samples, so the filter also makes up the halved level
+    upTaps = downTaps;
+    juce::FloatVectorOperations::multiply(upTaps.data(), 2.0f, (int)upTaps.size());
+}
+
+void HalfBandStage::prepare(int numChannels, int maxInputSamples) {
+    auto numHistory = (size_t)(2 * numTapPairs - 1);
+
+    channels.clear();
+    channels.resize((size_t)numChannels);
+    for (auto& channel : channels) {
+        channel.upHistory.assign(numHistory + (size_t)maxInputSamples, 0.0f);
+        channel.downEvenHistory.assign(numHistory + (size_t)maxInputSamples, 0.0f);
+        channel.downOddHistory.assign((size_t)numTapPairs + (size_t)maxInputSamples, 0.0f);
+    }
+    phaseBuffer.assign((size_t)maxInputSamples, 0.0f);
+}
+
+void HalfBandStage::reset() {
+    for (auto& channel : channels) {
+        for (auto* history : { &channel.upHistory, &channel.downEvenHistory, &channel.downOddHistory }) {
+            std::fill(history->begin(), history->end(), 0.0f);
+        }
+    }
+}
+
+int HalfBandStage::getLatency() const {
+    return 2 * numTapPairs - 1;
+}
+
+void HalfBandStage::upsample(int channel, const float* input, float* output, int numInputSamples) {
+    auto& state = channels[(size_t)channel];
+    auto numHistory = 2 * numTapPairs - 1;
+    jassert(numHistory + numInputSamples <= (int)state.upHistory.size());
+
+    float* samples = state.upHistory.data() + numHistory;
+    std::copy(input, input + numInputSamples, samples);
+
+    // Even outputs are the filtered phase, odd outputs the centre tap's delayed copy of the input
+    convolve(samples, upTaps, phaseBuffer.data(), numInputSamples);
+    const float* delayed = samples - (numTapPairs - 1);
+
+    for (int n = 0; n < numInputSamples; n++) {
+        output[2 * n] = phaseBuffer[(size_t)n];
+        output[2 * n + 1] = delayed[n];
+    }
+
+    std::copy(state.upHistory.begin() + numInputSamples, state.upHistory.begin() + numInputSamples + numHistory, state.upHistory.begin());
+}
+
+void HalfBandStage::downsample(int channel, const float* input, float* output, int numOutputSamples) {
+    auto& state = channels[(size_t)channel];
+    auto numHistory = 2 * numTapPairs - 1;
+    jassert(numHistory + numOutputSamples <= (int)state.downEvenHistory.size());
+
+    float* even = state.downEvenHistory.data() + numHistory;
+    float* odd = state.downOddHistory.data() + numTapPairs;
+    for (int n = 0; n < numOutputSamples; n++) {
+        even[n] = input[2 * n];
+        odd[n] = input[2 * n + 1];
+    }
+
+    // The centre tap lands on the odd sample numTapPairs samples back
+    convolve(even, downTaps, output, numOutputSamples);
+    juce::FloatVectorOperations::addWithMultiply(output, odd - numTapPairs, 0.5f, numOutputSamples);
+
+    std::copy(state.downEvenHistory.begin() + numOutputSamples, state.downEvenHistory.begin() + numOutputSamples + numHistory, state.downEvenHistory.begin());
+    std::copy(state.downOddHistory.begin() + numOutputSamples, state.downOddHistory.begin() + numOutputSamples + numTapPairs, state.downOddHistory.begin());
+}
+
+/*
+*   Oversampler
+*/
+void Oversampler::prepare(int newNumChannels, int newMaxBlockSize) {
+    numChannels = newNumChannels;
+    maxBlockSize = newMaxBlockSize;
+
+    stages.clear();
+    stageBuffers.clear();
+    stageBuffers.resize((size_t)maxStages);
+
+    for (int i = 0; i < maxStages; i++) {
+        stages.push_back(std::make_unique<HalfBandStage>(stageTapPairs[i]));
+        stages.back()->prepare(numChannels, maxBlockSize << i);
+        stageBuffers[(size_t)i].setSize(numChannels, maxBlockSize << (i + 1));
+    }
+}
+
+void Oversampler::reset() {
+    for (auto& stage : stages) {
+        stage->reset();
+    }
+}
+
+void Oversampler::setNumStages(int newNumStages) {
+    jassert(newNumStages >= 0 && newNumStages <= maxStages);
+
+    numStages = jlimit(0, maxStages, newNumStages);
+    reset();
+}
+
+int Oversampler::getNumStages() const {
+    return numStages;
+}
+
+int Oversampler::getFactor() const {
+    return 1 << numStages;
+}
+
+double Oversampler::getLatencyInSamples() const {
+    // Each stage delays both directions by its latency at the higher rate
+    double latency = 0.0;
+    for (int i = 0; i < numStages; i++) {
+        latency += 2.0 * stages[(size_t)i]->getLatency() / (double)(2 << i);
+    }
+    return latency;
+}
+
+juce::dsp::AudioBlock<float> Oversampler::processUp(juce::AudioBuffer<float>& buffer, int startSample, int numSamples) {
+    if (numStages == 0 || stages.empty())
+        return juce::dsp::AudioBlock<float>(buffer).getSubBlock((size_t)startSample, (size_t)numSamples);
+
+    jassert(numSamples <= maxBlockSize);
+    auto numProcessedChannels = jmin(numChannels, buffer.getNumChannels());
+
+    for (int i = 0; i < numStages; i++) {
+        for (int channel = 0; channel < numProcessedChannels; channel++) {
+            const float* source = i == 0 ? buffer.getReadPointer(channel, startSample) : stageBuffers[(size_t)i - 1].getReadPointer(channel);
+            stages[(size_t)i]->upsample(channel, source, stageBuffers[(size_t)i].getWritePointer(channel), numSamples << i);
+        }
+    }
+
+    return juce::dsp::AudioBlock<float>(stageBuffers[(size_t)numStages - 1])
+        .getSubsetChannelBlock(0, (size_t)numProcessedChannels)
+        .getSubBlock(0, (size_t)(numSamples << numStages));
+}
+
+void Oversampler::processDown(juce::AudioBuffer<float>& buffer, int startSample, int numSamples) {
+    if (numStages == 0 || stages.empty())
+        return;
+
+    auto numProcessedChannels = jmin(numChannels, buffer.getNumChannels());
+
+    for (int i = numStages - 1; i >= 0; i--) {
+        for (int channel = 0; channel < numProcessedChannels; channel++) {
+            float* destination = i == 0 ? buffer.getWritePointer(channel, startSample) : stageBuffers[(size_t)i - 1].getWritePointer(channel);
+            stages[(size_t)i]->downsample(channel, stageBuffers[(size_t)i].getReadPointer(channel), destination, numSamples << i);
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <JuceHeader.h>
+#include <vector>
+
+// One 2x step of a linear phase half-band FIR, in polyphase form. Every other tap of a half-band filter is zero
+// except the centre one, so each direction is a single short FIR on one phase and a plain delay on the other.
+class HalfBandStage {
+public:
+	// The filter is 4 * numTapPairs - 1 taps long
+	explicit HalfBandStage(int numTapPairs);
+
+	// Allocates the history of every channel; nothing else allocates
+	void prepare(int numChannels, int maxInputSamples);
+	void reset();
+
+	// Writes 2 * numInputSamples samples
+	void upsample(int channel, const float* input, float* output, int numInputSamples);
+
+	// Reads 2 * numOutputSamples samples
+	void downsample(int channel, const float* input, float* output, int numOutputSamples);
+
+	// Delay of one direction, in samples at the higher rate
+	int getLatency() const;
+
+private:
+	struct Channel {
+		std::vector<float> upHistory;
+		std::vector<float> downEvenHistory, downOddHistory;
+	};
+
+	int numTapPairs;
+	std::vector<float> upTaps, downTaps;
+	std::vector<Channel> channels;
+	std::vector<float> phaseBuffer;
+};
+
+// Cascade of half-band stages that runs part of processBlock at 2, 4 or 8 times the host rate. Every stage and buffer
+// for the highest factor is allocated in prepare(), so process() and setNumStages() are safe on the audio thread.
+class Oversampler {
+public:
+	static constexpr int maxStages = 3;
+
+	void prepare(int numChannels, int maxBlockSize);
+	void reset();
+
+	// Switches the factor to 2 ^ numStages and clears the filters; the latency changes with it
+	void setNumStages(int newNumStages);
+	int getNumStages() const;
+	int getFactor() const;
+
+	// Delay added by upsampling and downsampling again, in samples at the host rate
+	double getLatencyInSamples() const;
+
+	// Upsamples the buffer, calls processOversampled with an AudioBlock at the higher rate and downsamples the result back
+	// into the buffer. Buffers longer than the prepared block size are worked through in pieces that fit.
+	template <typename ProcessFunction>
+	void process(juce::AudioBuffer<float>& buffer, ProcessFunction&& processOversampled) {
+		auto numSamples = buffer.getNumSamples();
+		auto chunkSize = juce::jmax(1, maxBlockSize);
+
+		for (int start = 0; start < numSamples; start += chunkSize) {
+			auto numChunkSamples = juce::jmin(chunkSize, numSamples - start);
+			processOversampled(processUp(buffer, start, numChunkSamples));
+			processDown(buffer, start, numChunkSamples);
+		}
+	}
+
+private:
+	// The block is only valid until the matching processDown()
+	juce::dsp::AudioBlock<float> processUp(juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
+	void processDown(juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
+
+	std::vector<std::unique_ptr<HalfBandStage>> stages;
+
+	// Output of each upsampling stage, which the matching downsampling stage reads back
+	std::vector<juce::AudioBuffer<float>> stageBuffers;
+
+	int numStages = 0;
+	int numChannels = 0;
+	int maxBlockSize = 0;
+};
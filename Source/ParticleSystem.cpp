@@ -0,0 +1,411 @@
+#include "ParticleSystem.h"
+
+namespace {
+    const float invsqrt2 = 1.0f / sqrt(2.0f);
+
+    // Fraction of velocity left after one second
+    const float dragPerSecond = 0.25f;
+
+    const int minBurstSize = 16;
+    const int maxExtraBurstSize = 112;
+
+    struct MeshVertex {
+        float position[3];
+        float normal[3];
+    };
+
+    juce::OpenGLShaderProgram::Uniform* createUniform(juce::OpenGLShaderProgram& shaderProgram, const juce::String& uniformName) {
+        using namespace ::juce::gl;
+
+        if (glGetUniformLocation(shaderProgram.getProgramID(), uniformName.toRawUTF8()) < 0)
+            return nullptr;
+
+        return new juce::OpenGLShaderProgram::Uniform(shaderProgram, uniformName.toRawUTF8());
+    }
+}
+
+ParticleSystem::ParticleSystem() {
+    for (auto* array : { &positionX, &positionY, &positionZ, &velocityX, &velocityY, &velocityZ,
+                         &axisX, &axisY, &axisZ, &angle, &angularVelocity, &baseScale, &scale,
+                         &colourRed, &colourGreen, &colourBlue, &alpha, &age, &inverseLifetime, &lifeFraction }) {
+        array->resize(maxParticles);
+    }
+    instances.resize(maxParticles);
+}
+
+ParticleSystem::~ParticleSystem() {
+}
+
+int ParticleSystem::getNumParticles() const {
+    return numParticles;
+}
+
+void ParticleSystem::spawnBurst(int noteNumber, float velocity) {
+    auto colour = juce::Colour::fromHSV((float)(noteNumber % 12) / 12.0f, 0.8f, 1.0f, 1.0f);
+    auto burstSize = jmin(maxParticles - numParticles, minBurstSize + roundToInt(velocity * (float)maxExtraBurstSize));
+    auto speed = 1.5f + 4.0f * velocity;
+
+    for (int b = 0; b < burstSize; b++) {
+        auto i = numParticles++;
+
+        // Uniformly distributed direction on the unit sphere
+        auto z = 2.0f * random.nextFloat() - 1.0f;
+        auto phi = juce::MathConstants<float>::twoPi * random.nextFloat();
+        auto r = std::sqrt(1.0f - z * z);
+        auto particleSpeed = speed * (0.5f + 0.5f * random.nextFloat());
+
+        positionX[i] = 0.0f;
+        positionY[i] = 0.0f;
+        positionZ[i] = 0.0f;
+        velocityX[i] = particleSpeed * r * std::cos(phi);
+        velocityY[i] = particleSpeed * r * std::sin(phi);
+        velocityZ[i] = particleSpeed * z;
+
+        auto axisZ0 = 2.0f * random.nextFloat() - 1.0f;
+        auto axisPhi = juce::MathConstants<float>::twoPi * random.nextFloat();
+        auto axisR = std::sqrt(1.0f - axisZ0 * axisZ0);
+        axisX[i] = axisR * std::cos(axisPhi);
+        axisY[i] = axisR * std::sin(axisPhi);
+        axisZ[i] = axisZ0;
+        angle[i] = juce::MathConstants<float>::twoPi * random.nextFloat();
+        angularVelocity[i] = 8.0f * random.nextFloat() - 4.0f;
+
+        baseScale[i] = 0.05f + 0.1f * random.nextFloat();
+        scale[i] = baseScale[i];
+        colourRed[i] = colour.getFloatRed();
+        colourGreen[i] = colour.getFloatGreen();
+        colourBlue[i] = colour.getFloatBlue();
+        alpha[i] = 1.0f;
+
+        age[i] = 0.0f;
+        inverseLifetime[i] = 1.0f / (1.5f + 1.5f * random.nextFloat());
+        lifeFraction[i] = 0.0f;
+    }
+}
+
+void ParticleSystem::update(float dt) {
+    using FVO = juce::FloatVectorOperations;
+
+    if (numParticles == 0)
+        return;
+
+    auto n = numParticles;
+    auto drag = std::pow(dragPerSecond, dt);
+
+    FVO::addWithMultiply(positionX.data(), velocityX.data(), dt, n);
+    FVO::addWithMultiply(positionY.data(), velocityY.data(), dt, n);
+    FVO::addWithMultiply(positionZ.data(), velocityZ.data(), dt, n);
+    FVO::multiply(velocityX.data(), drag, n);
+    FVO::multiply(velocityY.data(), drag, n);
+    FVO::multiply(velocityZ.data(), drag, n);
+    FVO::addWithMultiply(angle.data(), angularVelocity.data(), dt, n);
+
+    // Fade out and shrink over the particle's lifetime: alpha = clamp(1 - age / lifetime)
+    FVO::add(age.data(), dt, n);
+    FVO::multiply(lifeFraction.data(), age.data(), inverseLifetime.data(), n);
+    FVO::negate(alpha.data(), lifeFraction.data(), n);
+    FVO::add(alpha.data(), 1.0f, n);
+    FVO::clip(alpha.data(), alpha.data(), 0.0f, 1.0f, n);
+    FVO::multiply(scale.data(), baseScale.data(), alpha.data(), n);
+
+    removeDeadParticles();
+}
+
+void ParticleSystem::removeDeadParticles() {
+    std::vector<float>* arrays[] = { &positionX, &positionY, &positionZ, &velocityX, &velocityY, &velocityZ,
+                                     &axisX, &axisY, &axisZ, &angle, &angularVelocity, &baseScale, &scale,
+                                     &colourRed, &colourGreen, &colourBlue, &alpha, &age, &inverseLifetime, &lifeFraction };
+
+    // Swap-remove keeps the arrays dense; draw order doesn't matter
+    int i = 0;
+    while (i < numParticles) {
+        if (lifeFraction[i] >= 1.0f) {
+            numParticles--;
+            for (auto* array : arrays) {
+                (*array)[i] = (*array)[numParticles];
+            }
+        }
+        else {
+            i++;
+        }
+    }
+}
+
+void ParticleSystem::packInstances() {
+    for (int i = 0; i < numParticles; i++) {
+        auto& instance = instances[i];
+        instance.position[0] = positionX[i];
+        instance.position[1] = positionY[i];
+        instance.position[2] = positionZ[i];
+        instance.scale = scale[i];
+        instance.axisAngle[0] = axisX[i];
+        instance.axisAngle[1] = axisY[i];
+        instance.axisAngle[2] = axisZ[i];
+        instance.axisAngle[3] = angle[i];
+        instance.colour[0] = colourRed[i];
+        instance.colour[1] = colourGreen[i];
+        instance.colour[2] = colourBlue[i];
+        instance.colour[3] = alpha[i];
+    }
+}
+
+void ParticleSystem::initialise(juce::OpenGLContext& openGLContext, const GLCapabilities& capabilities) {
+    using namespace ::juce::gl;
+
+    // Flat shaded base tetrahedron, the same shape Hedrite mounts
+    Vector3D<float> points[4] = {
+       Vector3D<float>(1.0f, 0.0f, invsqrt2),
+       Vector3D<float>(-1.0f, 0.0f, invsqrt2),
+       Vector3D<float>(0.0f, -1.0f, -invsqrt2),
+       Vector3D<float>(0.0f, 1.0f, -invsqrt2),
+    };
+    int order[12]{
+            0, 1, 2,
+            0, 3, 1,
+            1, 3, 2,
+            2, 3, 0
+    };
+
+    juce::Array<MeshVertex> vertices;
+    for (int face = 0; face < 4; face++) {
+        auto a = points[order[face * 3]];
+        auto b = points[order[face * 3 + 1]];
+        auto c = points[order[face * 3 + 2]];
+        auto n = -(c - a) ^ (b - a);
+
+        for (auto& p : { a, b, c }) {
+            vertices.add({ { p.x, p.y, p.z }, { n.x, n.y, n.z } });
+        }
+    }
+    numMeshVertices = vertices.size();
+    canDrawInstanced = capabilities.canDrawInstanced;
+
+    glGenBuffers(1, &meshBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, meshBuffer);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr> (static_cast<size_t> (numMeshVertices) * sizeof(MeshVertex)),
+        vertices.getRawDataPointer(), GL_STATIC_DRAW);
+
+    if (canDrawInstanced) {
+        glGenBuffers(1, &instanceBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr> (static_cast<size_t> (maxParticles) * sizeof(InstanceData)),
+            nullptr, GL_DYNAMIC_DRAW);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    juce::String vertexShader = R"(
+    attribute vec4 position;
+    attribute vec4 normal;
+    attribute vec3 instancePosition;
+    attribute float instanceScale;
+    attribute vec4 instanceAxisAngle;
+    attribute vec4 instanceColour;
+
+    uniform mat4 projectionMatrix;
+    uniform mat4 viewMatrix;
+    uniform vec4 lightPosition;
+
+    varying vec4 destinationColour;
+
+    vec3 rotate(vec3 v, vec4 axisAngle)
+    {
+        float c = cos(axisAngle.w);
+        float s = sin(axisAngle.w);
+        return v * c + cross(axisAngle.xyz, v) * s + axisAngle.xyz * dot(axisAngle.xyz, v) * (1.0 - c);
+    }
+
+    void main()
+    {
+        vec3 rotatedNormal = rotate(normal.xyz, instanceAxisAngle);
+        destinationColour = vec4(instanceColour.xyz*min(1.0, .5+max(dot(normalize(rotatedNormal), normalize(lightPosition.xyz)), 0.0)), instanceColour.w);
+        vec3 worldPosition = rotate(position.xyz, instanceAxisAngle) * instanceScale + instancePosition;
+        gl_Position = projectionMatrix * viewMatrix * vec4(worldPosition, 1.0);
+    })";
+    juce::String fragmentShader =
+#if JUCE_OPENGL_ES
+        R"(varying lowp vec4 destinationColour;)"
+#else
+        R"(varying vec4 destinationColour;)"
+#endif
+        R"(
+            void main()
+            {
+                gl_FragColor = destinationColour;
+            })";
+
+    std::unique_ptr<juce::OpenGLShaderProgram> newShader(new juce::OpenGLShaderProgram(openGLContext));
+
+    if (newShader->addVertexShader(juce::OpenGLHelpers::translateVertexShaderToV3(vertexShader))
+        && newShader->addFragmentShader(juce::OpenGLHelpers::translateFragmentShaderToV3(fragmentShader))
+        && newShader->link()) {
+        shader.reset(newShader.release());
+        shader->use();
+
+        attributes.reset(new Attributes(*shader));
+        projectionMatrixUniform.reset(createUniform(*shader, "projectionMatrix"));
+        viewMatrixUniform.reset(createUniform(*shader, "viewMatrix"));
+        lightPositionUniform.reset(createUniform(*shader, "lightPosition"));
+    }
+    else {
+        DBG("--- Particle shader failed: " + newShader->getLastError() + " ---");
+    }
+}
+
+void ParticleSystem::shutdown() {
+    using namespace ::juce::gl;
+
+    attributes.reset();
+    projectionMatrixUniform.reset();
+    viewMatrixUniform.reset();
+    lightPositionUniform.reset();
+    shader.reset();
+
+    if (meshBuffer != 0) {
+        glDeleteBuffers(1, &meshBuffer);
+        meshBuffer = 0;
+    }
+    if (instanceBuffer != 0) {
+        glDeleteBuffers(1, &instanceBuffer);
+        instanceBuffer = 0;
+    }
+}
+
+void ParticleSystem::draw(const Matrix3D<float>& projectionMatrix, const Matrix3D<float>& viewMatrix, const Vector3D<float>& lightPosition) {
+    using namespace ::juce::gl;
+
+    if (numParticles == 0 || shader == nullptr)
+        return;
+
+    packInstances();
+    shader->use();
+
+    if (projectionMatrixUniform != nullptr)
+        projectionMatrixUniform->setMatrix4(projectionMatrix.mat, 1, false);
+
+    if (viewMatrixUniform != nullptr)
+        viewMatrixUniform->setMatrix4(viewMatrix.mat, 1, false);
+
+    if (lightPositionUniform != nullptr)
+        lightPositionUniform->set(lightPosition.x, lightPosition.y, lightPosition.z, 1.0f);
+
+    if (canDrawInstanced) {
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr> (static_cast<size_t> (numParticles) * sizeof(InstanceData)), instances.data());
+
+        attributes->enable(meshBuffer, instanceBuffer);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, numMeshVertices, numParticles);
+        attributes->disable();
+    }
+    else {
+        attributes->enableMesh(meshBuffer);
+        for (int i = 0; i < numParticles; i++) {
+            attributes->setInstance(instances[(size_t)i]);
+            glDrawArrays(GL_TRIANGLES, 0, numMeshVertices);
+        }
+        attributes->disableMesh();
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/*
+*   Attributes
+*/
+ParticleSystem::Attributes::Attributes(juce::OpenGLShaderProgram& shaderProgram) {
+    position.reset(createAttribute(shaderProgram, "position"));
+    normal.reset(createAttribute(shaderProgram, "normal"));
+    instancePosition.reset(createAttribute(shaderProgram, "instancePosition"));
+    instanceScale.reset(createAttribute(shaderProgram, "instanceScale"));
+    instanceAxisAngle.reset(createAttribute(shaderProgram, "instanceAxisAngle"));
+    instanceColour.reset(createAttribute(shaderProgram, "instanceColour"));
+}
+
+void ParticleSystem::Attributes::enable(GLuint meshBuffer, GLuint instanceBuffer) {
+    using namespace ::juce::gl;
+
+    enableMesh(meshBuffer);
+
+    // The instance attributes advance once per tetrahedron instead of once per vertex
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+
+    if (instancePosition.get() != nullptr) {
+        glVertexAttribPointer(instancePosition->attributeID, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (GLvoid*)offsetof(InstanceData, position));
+        glVertexAttribDivisor(instancePosition->attributeID, 1);
+        glEnableVertexAttribArray(instancePosition->attributeID);
+    }
+
+    if (instanceScale.get() != nullptr) {
+        glVertexAttribPointer(instanceScale->attributeID, 1, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (GLvoid*)offsetof(InstanceData, scale));
+        glVertexAttribDivisor(instanceScale->attributeID, 1);
+        glEnableVertexAttribArray(instanceScale->attributeID);
+    }
+
+    if (instanceAxisAngle.get() != nullptr) {
+        glVertexAttribPointer(instanceAxisAngle->attributeID, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (GLvoid*)offsetof(InstanceData, axisAngle));
+        glVertexAttribDivisor(instanceAxisAngle->attributeID, 1);
+        glEnableVertexAttribArray(instanceAxisAngle->attributeID);
+    }
+
+    if (instanceColour.get() != nullptr) {
+        glVertexAttribPointer(instanceColour->attributeID, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (GLvoid*)offsetof(InstanceData, colour));
+        glVertexAttribDivisor(instanceColour->attributeID, 1);
+        glEnableVertexAttribArray(instanceColour->attributeID);
+    }
+}
+
+void ParticleSystem::Attributes::disable() {
+    using namespace ::juce::gl;
+
+    disableMesh();
+
+    // Reset the divisors so the attribute slots behave normally for the other shaders
+    for (auto* attribute : { instancePosition.get(), instanceScale.get(), instanceAxisAngle.get(), instanceColour.get() }) {
+        if (attribute != nullptr) {
+            glVertexAttribDivisor(attribute->attributeID, 0);
+            glDisableVertexAttribArray(attribute->attributeID);
+        }
+    }
+}
+
+void ParticleSystem::Attributes::enableMesh(GLuint meshBuffer) {
+    using namespace ::juce::gl;
+
+    glBindBuffer(GL_ARRAY_BUFFER, meshBuffer);
+
+    if (position.get() != nullptr) {
+        glVertexAttribPointer(position->attributeID, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), nullptr);
+        glEnableVertexAttribArray(position->attributeID);
+    }
+
+    if (normal.get() != nullptr) {
+        glVertexAttribPointer(normal->attributeID, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (GLvoid*)(sizeof(float) * 3));
+        glEnableVertexAttribArray(normal->attributeID);
+    }
+}
+
+void ParticleSystem::Attributes::disableMesh() {
+    using namespace ::juce::gl;
+
+    if (position.get() != nullptr)       glDisableVertexAttribArray(position->attributeID);
+    if (normal.get() != nullptr)         glDisableVertexAttribArray(normal->attributeID);
+}
+
+void ParticleSystem::Attributes::setInstance(const InstanceData& instance) {
+    using namespace ::juce::gl;
+
+    // A disabled attribute array reads its current constant value for every vertex
+    if (instancePosition.get() != nullptr)   glVertexAttrib3fv(instancePosition->attributeID, instance.position);
+    if (instanceScale.get() != nullptr)      glVertexAttrib1f(instanceScale->attributeID, instance.scale);
+    if (instanceAxisAngle.get() != nullptr)  glVertexAttrib4fv(instanceAxisAngle->attributeID, instance.axisAngle);
+    if (instanceColour.get() != nullptr)     glVertexAttrib4fv(instanceColour->attributeID, instance.colour);
+}
+
+juce::OpenGLShaderProgram::Attribute* ParticleSystem::Attributes::createAttribute(juce::OpenGLShaderProgram& shader,
+    const juce::String& attributeName) {
+    using namespace ::juce::gl;
+
+    if (glGetAttribLocation(shader.getProgramID(), attributeName.toRawUTF8()) < 0)
+        return nullptr;
+
+    return new juce::OpenGLShaderProgram::Attribute(shader, attributeName.toRawUTF8());
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <JuceHeader.h>
+#include <vector>
+#include "GLCapabilities.h"
+
+// Bursts of tetrahedra spawned by notes. Particle state lives in struct-of-arrays form so the update is a
+// handful of vectorised passes, and every particle is drawn from one base mesh with a single instanced draw call.
+// Contexts without instanced arrays fall back to one draw call per particle.
+class ParticleSystem {
+public:
+	static constexpr int maxParticles = 8192;
+
+	// Per-instance data uploaded to the GPU each frame
+	struct InstanceData {
+		float position[3];
+		float scale;
+		float axisAngle[4];
+		float colour[4];
+	};
+
+	ParticleSystem();
+	~ParticleSystem();
+
+	void spawnBurst(int noteNumber, float velocity);
+	void update(float dt);
+	int getNumParticles() const;
+
+	// GL resources; must be called with the OpenGL context active
+	void initialise(juce::OpenGLContext& openGLContext, const GLCapabilities& capabilities);
+	void shutdown();
+	void draw(const Matrix3D<float>& projectionMatrix, const Matrix3D<float>& viewMatrix, const Vector3D<float>& lightPosition);
+
+private:
+	struct Attributes {
+		std::unique_ptr<juce::OpenGLShaderProgram::Attribute> position, normal, instancePosition, instanceScale, instanceAxisAngle, instanceColour;
+		Attributes(juce::OpenGLShaderProgram& shaderProgram);
+		void enable(GLuint meshBuffer, GLuint instanceBuffer);
+		void disable();
+
+		// Mesh attributes only; the instance attributes are then set as constants before each draw
+		void enableMesh(GLuint meshBuffer);
+		void disableMesh();
+		void setInstance(const InstanceData& instance);
+	private:
+		static juce::OpenGLShaderProgram::Attribute* createAttribute(juce::OpenGLShaderProgram& shader, const juce::String& attributeName);
+	};
+
+	void removeDeadParticles();
+	void packInstances();
+
+	int numParticles = 0;
+
+	// Struct-of-arrays particle state, each sized to maxParticles
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> velocityX, velocityY, velocityZ;
+	std::vector<float> axisX, axisY, axisZ;
+	std::vector<float> angle, angularVelocity;
+	std::vector<float> baseScale, scale;
+	std::vector<float> colourRed, colourGreen, colourBlue, alpha;
+	std::vector<float> age, inverseLifetime, lifeFraction;
+
+	std::vector<InstanceData> instances;
+	juce::Random random;
+
+	std::unique_ptr<juce::OpenGLShaderProgram> shader;
+	std::unique_ptr<Attributes> attributes;
+	std::unique_ptr<juce::OpenGLShaderProgram::Uniform> projectionMatrixUniform, viewMatrixUniform, lightPositionUniform;
+	GLuint meshBuffer = 0, instanceBuffer = 0;
+	int numMeshVertices = 0;
+	bool canDrawInstanced = false;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ParticleSystem)
+};
@@ -0,0 +1,349 @@
+#include "PartitionedConvolution.h"
+#include "RealtimeGuard.h"
+
+namespace {
+    // acc += a * b over interleaved complex values
+    void multiplyAccumulate(float* acc, const float* a, const float* b, int numBins) {
+        for (int k = 0; k < numBins; k++) {
+            auto ar = a[2 * k], ai = a[2 * k + 1];
+            auto br = b[2 * k], bi = b[2 * k + 1];
+            acc[2 * k] += ar * br - ai * bi;
+            acc[2 * k + 1] += ar * bi + ai * br;
+        }
+    }
+
+    // Four independent sums so the compiler can keep the products in vector registers
+    float dotProduct(const float* a, const float* b, int num) {
+        float sum0 = 0.0f, sum1 = 0.0f, sum2 = 0.0f, sum3 = 0.0f;
+        int i = 0;
+        for (; i + 4 <= num; i += 4) {
+            sum0 += a[i] * b[i];
+            sum1 += a[i + 1] * b[i + 1];
+            sum2 += a[i + 2] * b[i + 2];
+            sum3 += a[i + 3] * b[i + 3];
+        }
+        for (; i < num; i++) {
+            sum0 += a[i] * b[i];
+        }
+        return (sum0 + sum1) + (sum2 + sum3);
+    }
+}
+
+/*
+*   UniformPartitionedConvolver
+*/
+void UniformPartitionedConvolver::prepare(const float* impulse, int impulseLength, int newBlockSize) {
+    jassert(juce::isPowerOfTwo(newBlockSize));
+
+    blockSize = newBlockSize;
+    fftSize = 2 * blockSize;
+    numBins = fftSize / 2 + 1;
+    numPartitions = impulseLength > 0 ? (impulseLength + blockSize - 1) / blockSize : 0;
+    currentSlot = 0;
+
+    fft = std::make_unique<juce::dsp::FFT>(roundToInt(std::log2((double)fftSize)));
+    workBuffer.assign(2 * fftSize, 0.0f);
+    inputWindow.assign(fftSize, 0.0f);
+    partitionSpectra.assign((size_t)numPartitions * numBins * 2, 0.0f);
+    inputSpectra.assign(partitionSpectra.size(), 0.0f);
+
+    // Each partition is zero padded to the FFT size so the circular convolution doesn't wrap
+    for (int p = 0; p < numPartitions; p++) {
+        std::fill(workBuffer.begin(), workBuffer.end(), 0.0f);
+        auto numTaps = jmin(blockSize, impulseLength - p * blockSize);
+        std::copy(impulse + p * blockSize, impulse + p * blockSize + numTaps, workBuffer.begin());
+
+        fft->performRealOnlyForwardTransform(workBuffer.data(), true);
+        std::copy(workBuffer.begin(), workBuffer.begin() + 2 * numBins, partitionSpectra.begin() + (size_t)p * numBins * 2);
+    }
+}
+
+void UniformPartitionedConvolver::reset() {
+    std::fill(inputSpectra.begin(), inputSpectra.end(), 0.0f);
+    std::fill(inputWindow.begin(), inputWindow.end(), 0.0f);
+    currentSlot = 0;
+}
+
+bool UniformPartitionedConvolver::isEmpty() const {
+    return numPartitions == 0;
+}
+
+void UniformPartitionedConvolver::process(const float* input, float* output) {
+    if (numPartitions == 0) {
+        juce::FloatVectorOperations::clear(output, blockSize);
+        return;
+    }
+
+    // Slide the window along by one block and transform it
+    std::copy(inputWindow.begin() + blockSize, inputWindow.end(), inputWindow.begin());
+    std::copy(input, input + blockSize, inputWindow.begin() + blockSize);
+
+    std::copy(inputWindow.begin(), inputWindow.end(), workBuffer.begin());
+    std::fill(workBuffer.begin() + fftSize, workBuffer.end(), 0.0f);
+    fft->performRealOnlyForwardTransform(workBuffer.data(), true);
+
+    float* newestSpectrum = inputSpectra.data() + (size_t)currentSlot * numBins * 2;
+    std::copy(workBuffer.begin(), workBuffer.begin() + 2 * numBins, newestSpectrum);
+
+    // Partition p is applied to the spectrum of the input from p blocks ago
+    std::fill(workBuffer.begin(), workBuffer.end(), 0.0f);
+    for (int p = 0; p < numPartitions; p++) {
+        auto slot = (currentSlot + numPartitions - p) % numPartitions;
+        multiplyAccumulate(workBuffer.data(), inputSpectra.data() + (size_t)slot * numBins * 2,
+            partitionSpectra.data() + (size_t)p * numBins * 2, numBins);
+    }
+    currentSlot = (currentSlot + 1) % numPartitions;
+
+    // The inverse transform wants the full spectrum, so mirror the conjugates into the negative frequencies
+    for (int k = 1; k < fftSize / 2; k++) {
+        workBuffer[2 * (fftSize - k)] = workBuffer[2 * k];
+        workBuffer[2 * (fftSize - k) + 1] = -workBuffer[2 * k + 1];
+    }
+    fft->performRealOnlyInverseTransform(workBuffer.data());
+
+    // Overlap-save: only the second half is free of wrap-around
+    std::copy(workBuffer.begin() + blockSize, workBuffer.begin() + fftSize, output);
+}
+
+/*
+*   ConvolutionStage
+*/
+ConvolutionStage::ConvolutionStage() : juce::Thread("Convolution tail") {
+}
+
+ConvolutionStage::~ConvolutionStage() {
+    stopThread(1000);
+}
+
+void ConvolutionStage::prepare(const juce::AudioBuffer<float>& impulseResponse, int numChannels) {
+    // The worker must be idle before its buffers are replaced
+    release();
+    tailResetPending = tailJobShouldReset = false;
+    numLateTailBlocks = 0;
+
+    impulseLength = impulseResponse.getNumSamples();
+    hasTail = impulseLength > 2 * tailBlockSize;
+    headPosition = midPosition = tailPosition = 0;
+
+    channels.clear();
+    channels.resize((size_t)numChannels);
+
+    for (int c = 0; c < numChannels; c++) {
+        auto& channel = channels[(size_t)c];
+        const float* impulse = impulseResponse.getReadPointer(c % jmax(1, impulseResponse.getNumChannels()));
+
+        channel.headTaps.assign(headSize, 0.0f);
+        std::copy(impulse, impulse + jmin(headSize, impulseLength), channel.headTaps.begin());
+        channel.headHistory.assign(2 * headSize, 0.0f);
+
+        auto midLength = jmax(0, jmin(impulseLength, 2 * tailBlockSize) - headSize);
+        channel.mid.prepare(impulse + jmin(headSize, impulseLength), midLength, headSize);
+        channel.midInput.assign(headSize, 0.0f);
+        channel.midOutput.assign(headSize, 0.0f);
+
+        auto tailLength = jmax(0, impulseLength - 2 * tailBlockSize);
+        channel.tail.prepare(impulse + (hasTail ? 2 * tailBlockSize : 0), tailLength, tailBlockSize);
+        for (auto* tailBuffer : { &channel.tailInput, &channel.tailOutput, &channel.tailJobInput, &channel.tailJobOutput }) {
+            tailBuffer->assign(tailBlockSize, 0.0f);
+        }
+    }
+
+    // The worker has a whole tail block to finish each job, but only if the scheduler doesn't leave it behind the GUI
+    if (hasTail) {
+        startThread(juce::Thread::Priority::highest);
+    }
+}
+
+void ConvolutionStage::release() {
+    stopThread(1000);
+    tailJobState = tailJobIdle;
+    hasTail = false;
+}
+
+void ConvolutionStage::setNonRealtime(bool isNonRealtime) {
+    waitForTailJobs.store(isNonRealtime, std::memory_order_relaxed);
+}
+
+void ConvolutionStage::reset() {
+    headPosition = midPosition = tailPosition = 0;
+    for (auto& channel : channels) {
+        channel.mid.reset();
+        for (auto* channelBuffer : { &channel.headHistory, &channel.midInput, &channel.midOutput, &channel.tailInput, &channel.tailOutput }) {
+            std::fill(channelBuffer->begin(), channelBuffer->end(), 0.0f);
+        }
+    }
+
+    // The tail convolver and job buffers may belong to the worker right now, so they're cleared with the next job
+    tailResetPending = true;
+}
+
+void ConvolutionStage::setWetLevel(float newWetLevel) {
+    wetLevel = newWetLevel;
+}
+
+int ConvolutionStage::getImpulseLength() const {
+    return impulseLength;
+}
+
+int ConvolutionStage::getNumLateTailBlocks() const {
+    return numLateTailBlocks.load();
+}
+
+void ConvolutionStage::process(juce::AudioBuffer<float>& buffer) {
+    if (channels.empty())
+        return;
+
+    jassert(buffer.getNumChannels() >= (int)channels.size());
+    auto numChannels = jmin(buffer.getNumChannels(), (int)channels.size());
+    auto numSamples = buffer.getNumSamples();
+
+    // Work in chunks that end on head block boundaries; tail boundaries are always head boundaries too
+    for (int start = 0; start < numSamples;) {
+        auto chunkSize = jmin(numSamples - start, headSize - midPosition);
+
+        for (int c = 0; c < numChannels; c++) {
+            auto& channel = channels[(size_t)c];
+            float* data = buffer.getWritePointer(c, start);
+            float* history = channel.headHistory.data();
+            auto position = headPosition;
+
+            for (int i = 0; i < chunkSize; i++) {
+                auto x = data[i];
+
+                // Doubled history buffer, so the newest headSize samples are always contiguous from position
+                history[position] = history[position + headSize] = x;
+                auto y = dotProduct(channel.headTaps.data(), history + position, headSize);
+                position = position == 0 ? headSize - 1 : position - 1;
+
+                y += channel.midOutput[(size_t)(midPosition + i)];
+                channel.midInput[(size_t)(midPosition + i)] = x;
+
+                if (hasTail) {
+                    y += channel.tailOutput[(size_t)(tailPosition + i)];
+                    channel.tailInput[(size_t)(tailPosition + i)] = x;
+                }
+
+                data[i] = x + wetLevel * y;
+            }
+        }
+
+        headPosition = (headPosition - chunkSize % headSize + headSize) % headSize;
+        midPosition += chunkSize;
+        start += chunkSize;
+
+        if (midPosition == headSize) {
+            for (auto& channel : channels) {
+                channel.mid.process(channel.midInput.data(), channel.midOutput.data());
+            }
+            midPosition = 0;
+        }
+
+        if (hasTail) {
+            tailPosition += chunkSize;
+            if (tailPosition == tailBlockSize) {
+                finishTailBlock();
+                tailPosition = 0;
+            }
+        }
+    }
+}
+
+void ConvolutionStage::finishTailBlock() {
+    // The job in flight was handed over a whole tail block ago, so it's normally long finished
+    if (tailJobState.load(std::memory_order_acquire) == tailJobReady) {
+        if (waitForTailJobs.load(std::memory_order_relaxed)) {
+            HEDRITE_RT_BLOCKING_CALL();
+            while (tailJobState.load(std::memory_order_acquire) == tailJobReady) {
+                juce::Thread::yield();
+            }
+        }
+        else {
+            // Rather than block, leave the worker to it and play the next tail block silent. This block's input never
+            // reaches the tail, and the late result comes out one block late.
+            for (auto& channel : channels) {
+                std::fill(channel.tailOutput.begin(), channel.tailOutput.end(), 0.0f);
+            }
+            numLateTailBlocks++;
+            return;
+        }
+    }
+
+    for (auto& channel : channels) {
+        std::swap(channel.tailOutput, channel.tailJobOutput);
+        std::swap(channel.tailInput, channel.tailJobInput);
+
+        // A result from before a reset belongs to the old signal
+        if (tailResetPending) {
+            std::fill(channel.tailOutput.begin(), channel.tailOutput.end(), 0.0f);
+        }
+    }
+
+    tailJobShouldReset = tailResetPending;
+    tailResetPending = false;
+    tailJobState.store(tailJobReady, std::memory_order_release);
+}
+
+void ConvolutionStage::run() {
+    while (!threadShouldExit()) {
+        if (tailJobState.load(std::memory_order_acquire) != tailJobReady) {
+            // A job arrives once per tail block, 20 ms or more, so a millisecond's poll costs little of the worker's
+            // time to finish it. Offline the audio thread is already waiting, so don't sleep.
+            if (waitForTailJobs.load(std::memory_order_relaxed))
+                juce::Thread::yield();
+            else
+                juce::Thread::sleep(1);
+            continue;
+        }
+
+        for (auto& channel : channels) {
+            if (tailJobShouldReset) {
+                channel.tail.reset();
+            }
+            channel.tail.process(channel.tailJobInput.data(), channel.tailJobOutput.data());
+        }
+        tailJobState.store(tailJobDone, std::memory_order_release);
+    }
+}
+
+juce::AudioBuffer<float> ConvolutionStage::createBodyImpulseResponse(double sampleRate, double lengthSeconds, int numChannels) {
+    // Modes at the ratios of the tetrahedron's edge, height and circumradius, over a diffuse decaying room
+    const double baseFrequency = 180.0;
+    const double modeRatios[] = { 1.0, std::sqrt(8.0 / 3.0), 2.0, std::sqrt(6.0), 3.0 };
+    const double modeDecaySeconds[] = { 0.35, 0.28, 0.22, 0.16, 0.12 };
+
+    auto length = jmax(1, roundToInt(sampleRate * lengthSeconds));
+    juce::AudioBuffer<float> impulseResponse(numChannels, length);
+
+    // Fixed seed so renders are repeatable
+    juce::Random random(0x7e7a);
+
+    for (int c = 0; c < numChannels; c++) {
+        float* data = impulseResponse.getWritePointer(c);
+        auto modePhase = juce::MathConstants<double>::pi * (double)c / (double)jmax(1, numChannels);
+
+        for (int i = 0; i < length; i++) {
+            auto t = (double)i / sampleRate;
+
+            // 60 dB of decay over the full length
+            auto room = (2.0 * random.nextDouble() - 1.0) * std::exp(-6.91 * t / lengthSeconds);
+
+            auto body = 0.0;
+            for (size_t m = 0; m < std::size(modeRatios); m++) {
+                body += std::sin(juce::MathConstants<double>::twoPi * baseFrequency * modeRatios[m] * t + modePhase) * std::exp(-t / modeDecaySeconds[m]);
+            }
+
+            data[i] = (float)(0.6 * room + 0.4 * body);
+        }
+
+        // Unit energy keeps the wet level independent of the response length
+        auto energy = 0.0;
+        for (int i = 0; i < length; i++) {
+            energy += (double)data[i] * data[i];
+        }
+        if (energy > 0.0) {
+            juce::FloatVectorOperations::multiply(data, (float)(1.0 / std::sqrt(energy)), length);
+        }
+    }
+
+    return impulseResponse;
+}
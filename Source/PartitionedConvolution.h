@@ -0,0 +1,107 @@
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+#include <vector>
+
+// Overlap-save convolution of fixed size blocks with one segment of an impulse response, split into partitions of the
+// block size and accumulated in the frequency domain. Output lags input by one block.
+class UniformPartitionedConvolver {
+public:
+	// Allocates everything; process() never does
+	void prepare(const float* impulse, int impulseLength, int blockSize);
+	void reset();
+
+	// Convolves exactly one block of input and writes one block of output
+	void process(const float* input, float* output);
+
+	bool isEmpty() const;
+
+private:
+	int blockSize = 0;
+	int fftSize = 0;
+	int numBins = 0;
+	int numPartitions = 0;
+	int currentSlot = 0;
+
+	std::unique_ptr<juce::dsp::FFT> fft;
+
+	// numPartitions spectra of numBins interleaved complex values each
+	std::vector<float> partitionSpectra;
+	std::vector<float> inputSpectra;
+
+	std::vector<float> inputWindow;
+	std::vector<float> workBuffer;
+};
+
+// Zero latency convolution for multi-second impulse responses. The first headSize samples of the response are applied
+// directly, the rest up to twice tailBlockSize with small FFT partitions on the audio thread, and the remainder with large
+// partitions on a worker thread, which has one whole tail block of time to deliver each result. In real time a late
+// result is never waited for; that tail block is played silent instead.
+class ConvolutionStage : private juce::Thread {
+public:
+	static constexpr int headSize = 128;
+	static constexpr int tailBlockSize = 2048;
+
+	ConvolutionStage();
+	~ConvolutionStage() override;
+
+	// Allocates all buffers and starts the worker; call from prepareToPlay, never while processing
+	void prepare(const juce::AudioBuffer<float>& impulseResponse, int numChannels);
+
+	// Offline renders wait for the worker instead of dropping late tail blocks, so bounces are always complete.
+	// Safe to call at any time; it applies from the next tail block.
+	void setNonRealtime(bool isNonRealtime);
+
+	// Stops the worker; the tail stays silent until the next prepare()
+	void release();
+
+	// Clears the reverb without blocking, so it's safe from the audio thread
+	void reset();
+
+	// Adds the wet signal to the buffer in place, without allocating
+	void process(juce::AudioBuffer<float>& buffer);
+
+	void setWetLevel(float newWetLevel);
+	int getImpulseLength() const;
+
+	// Tail blocks the worker didn't finish in time since prepare()
+	int getNumLateTailBlocks() const;
+
+	// Deterministic resonant body and room response for the tetrahedral instrument
+	static juce::AudioBuffer<float> createBodyImpulseResponse(double sampleRate, double lengthSeconds, int numChannels);
+
+private:
+	struct Channel {
+		std::vector<float> headTaps;
+		std::vector<float> headHistory;
+
+		UniformPartitionedConvolver mid, tail;
+		std::vector<float> midInput, midOutput;
+		std::vector<float> tailInput, tailOutput, tailJobInput, tailJobOutput;
+	};
+
+	void run() override;
+	void finishTailBlock();
+
+	std::vector<Channel> channels;
+	int impulseLength = 0;
+	int headPosition = 0;
+	int midPosition = 0;
+	int tailPosition = 0;
+	bool hasTail = false;
+	std::atomic<bool> waitForTailJobs{ false };
+
+	// A reset while a job is in flight discards its result, and the worker clears the tail's history before the next job
+	bool tailResetPending = false;
+	bool tailJobShouldReset = false;
+
+	// Handed back and forth with plain atomic loads and stores, so the audio thread never takes a lock; the worker polls.
+	// The job buffers and tailJobShouldReset belong to whichever side the state says.
+	enum TailJobState { tailJobIdle, tailJobReady, tailJobDone };
+	std::atomic<int> tailJobState{ tailJobIdle };
+
+	std::atomic<int> numLateTailBlocks{ 0 };
+	float wetLevel = 0.35f;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ConvolutionStage)
+};
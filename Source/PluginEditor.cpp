@@ -20,6 +20,7 @@ HedriteAudioProcessorEditor::HedriteAudioProcessorEditor (HedriteAudioProcessor&
     Hedrite::instance = &hedrite;
     hedrite.initialize();
     hedrite.openGLWindow->setInitializeCallback(Hedrite::openGLCallback);
+    hedrite.openGLWindow->setNoteEventQueue(&audioProcessor.noteEvents);
     addAndMakeVisible(*hedrite.openGLWindow);
 
 }
@@ -8,6 +8,8 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "Mesh.h"
+#include "RealtimeGuard.h"
 
 //==============================================================================
 HedriteAudioProcessor::HedriteAudioProcessor()
@@ -22,10 +24,23 @@ HedriteAudioProcessor::HedriteAudioProcessor()
                        )
 #endif
 {
+    for (int i = 0; i < numVoices; ++i)
+        synth.addVoice (new WavetableVoice());
+
+    synth.addSound (new WavetableSound());
+
+    addParameter (oversamplingFactor = new juce::AudioParameterChoice ("oversampling", "Oversampling", { "1x", "2x", "4x", "8x" }, 1));
+
+    // The oscillator plays the outline of the tetrahedron as seen from above
+    wavetableBank.requestTable (MipmappedWavetable::createSilhouetteCycle (Mesh::getTetrahedronPoints()));
+
+    // Polls for latency changes made on the audio thread
+    startTimer (50);
 }
 
 HedriteAudioProcessor::~HedriteAudioProcessor()
 {
+    stopTimer();
 }
 
 //==============================================================================
@@ -63,7 +78,11 @@ bool HedriteAudioProcessor::isMidiEffect() const
 
 double HedriteAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    if (getSampleRate() <= 0.0)
+        return impulseResponseSeconds + WavetableVoice::releaseSeconds;
+
+    // Released voices keep sounding through the body resonance for the whole impulse response
+    return convolution.getImpulseLength() / getSampleRate() + WavetableVoice::releaseSeconds;
 }
 
 int HedriteAudioProcessor::getNumPrograms()
@@ -95,12 +114,59 @@ void HedriteAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBloc
 {
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
+    auto numChannels = getTotalNumOutputChannels();
+
+    synth.prepare (sampleRate, samplesPerBlock, numChannels);
+
+    // Stages for the highest factor are allocated up front, so processBlock can switch factor without reallocating
+    for (auto& oversampler : oversamplers)
+        oversampler.prepare (numChannels, samplesPerBlock);
+
+    currentOversampler = 0;
+    oversamplers[currentOversampler].setNumStages (oversamplingFactor->getIndex());
+    crossfadeBuffer.setSize (numChannels, juce::jmax (1, samplesPerBlock));
+    crossfadeLength = juce::jmax (1, juce::roundToInt (sampleRate * oversamplingCrossfadeSeconds));
+    crossfadeSamplesRemaining = 0;
+
+    // Not on the audio thread here, so the host can be told straight away
+    oversamplingLatency = juce::roundToInt (oversamplers[currentOversampler].getLatencyInSamples());
+    setLatencySamples (oversamplingLatency);
+
+    convolution.prepare (ConvolutionStage::createBodyImpulseResponse (sampleRate, impulseResponseSeconds, numChannels), numChannels);
+    wasPlaying = false;
 }
 
 void HedriteAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+    synth.release();
+    convolution.release();
+
+    if (convolution.getNumLateTailBlocks() > 0)
+        DBG ("--- Convolution tail was late " << convolution.getNumLateTailBlocks() << " times ---");
+
+   #if HEDRITE_RT_GUARD
+    DBG (RealtimeGuard::createReport());
+    RealtimeGuard::reset();
+   #endif
+}
+
+void HedriteAudioProcessor::timerCallback()
+{
+    auto latency = oversamplingLatency.load();
+    if (latency != getLatencySamples())
+        setLatencySamples (latency);
+}
+
+void HedriteAudioProcessor::reset()
+{
+    // Called by hosts when the transport jumps or restarts; nothing from before should ring on
+    for (auto& oversampler : oversamplers)
+        oversampler.reset();
+
+    crossfadeSamplesRemaining = 0;
+    convolution.reset();
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -132,6 +198,20 @@ bool HedriteAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts)
 void HedriteAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
     juce::ScopedNoDenormals noDenormals;
+
+    // Debug builds record anything below that allocates, locks or waits. Offline renders may block on
+    // their worker threads, so they aren't checked.
+    RealtimeGuard::ScopedAudioThread audioThreadGuard (! isNonRealtime());
+
+    // Not every host prepares again when it switches to offline rendering, so the mode is followed block by block.
+    // Offline, voices spread over more threads and the reverb waits for its worker rather than dropping late blocks.
+    synth.setNonRealtime (isNonRealtime());
+    convolution.setNonRealtime (isNonRealtime());
+
+    // A bounce mustn't depend on how quickly the background builder finished
+    if (isNonRealtime() && ! wavetableBank.waitUntilBuilt (10000))
+        DBG ("--- Wavetable not built before offline render ---");
+
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
@@ -144,6 +224,46 @@ void HedriteAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
 
+    for (const auto metadata : midiMessages)
+    {
+        auto message = metadata.getMessage();
+        if (message.isNoteOn())
+            noteEvents.push ({ message.getNoteNumber(), message.getFloatVelocity() });
+    }
+
+    auto* wavetable = wavetableBank.acquireForAudio();
+    for (int i = 0; i < synth.getNumVoices(); ++i)
+        if (auto* voice = dynamic_cast<WavetableVoice*> (synth.getVoice (i)))
+            voice->setWavetable (wavetable);
+
+    // juce::Synthesiser holds its own lock for the whole block. Nothing here changes voices or sounds while playing, so
+    // it's never contended.
+    HEDRITE_RT_LOCKING_CALL();
+    synth.renderNextBlock (buffer, midiMessages, 0, buffer.getNumSamples());
+
+    // A changed or automated factor is faded in from this block on; the host hears of its latency from the timer.
+    // A change made during a fade waits for it to finish.
+    if (crossfadeSamplesRemaining == 0 && oversamplingFactor->getIndex() != oversamplers[currentOversampler].getNumStages())
+    {
+        currentOversampler = 1 - currentOversampler;
+        oversamplers[currentOversampler].setNumStages (oversamplingFactor->getIndex());
+        crossfadeSamplesRemaining = crossfadeLength;
+        oversamplingLatency = juce::roundToInt (oversamplers[currentOversampler].getLatencyInSamples());
+    }
+
+    saturate (buffer);
+
+    // Not every host calls reset() when playback restarts, so a stopped transport starting again clears the reverb too
+    if (auto* playHead = getPlayHead())
+    {
+        auto isPlaying = playHead->getPosition().orFallback (juce::AudioPlayHead::PositionInfo()).getIsPlaying();
+        if (isPlaying && ! wasPlaying)
+            convolution.reset();
+        wasPlaying = isPlaying;
+    }
+
+    convolution.process (buffer);
+
     // This is the place where you'd normally do the guts of your plugin's
     // audio processing...
     // Make sure to reset the state if your inner loop is processing
@@ -160,6 +280,64 @@ void HedriteAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce
 
 }
 
+void HedriteAudioProcessor::saturate (juce::AudioBuffer<float>& buffer)
+{
+    // Saturate the voice mix at the oversampled rate, so the harmonics it adds above Nyquist don't fold back down
+    auto saturation = [] (juce::dsp::AudioBlock<float> oversampledBlock)
+    {
+        for (size_t channel = 0; channel < oversampledBlock.getNumChannels(); ++channel)
+        {
+            auto* data = oversampledBlock.getChannelPointer (channel);
+            for (size_t i = 0; i < oversampledBlock.getNumSamples(); ++i)
+                data[i] = juce::dsp::FastMathApproximations::tanh (juce::jlimit (-5.0f, 5.0f, saturationDrive * data[i])) / saturationDrive;
+        }
+    };
+
+    if (crossfadeSamplesRemaining == 0)
+    {
+        oversamplers[currentOversampler].process (buffer, saturation);
+        return;
+    }
+
+    // The previous factor runs on a copy in crossfadeBuffer, so blocks longer than that are faded in pieces
+    auto& previousOversampler = oversamplers[1 - currentOversampler];
+    auto numChannels = juce::jmin (buffer.getNumChannels(), crossfadeBuffer.getNumChannels());
+    auto numSamples = buffer.getNumSamples();
+
+    for (int start = 0; start < numSamples; start += crossfadeBuffer.getNumSamples())
+    {
+        auto numChunkSamples = juce::jmin (crossfadeBuffer.getNumSamples(), numSamples - start);
+
+        // Buffers referring to existing channel data don't allocate
+        juce::AudioBuffer<float> chunk (buffer.getArrayOfWritePointers(), numChannels, start, numChunkSamples);
+
+        if (crossfadeSamplesRemaining == 0)
+        {
+            oversamplers[currentOversampler].process (chunk, saturation);
+            continue;
+        }
+
+        juce::AudioBuffer<float> previousChunk (crossfadeBuffer.getArrayOfWritePointers(), numChannels, 0, numChunkSamples);
+        for (int channel = 0; channel < numChannels; ++channel)
+            previousChunk.copyFrom (channel, 0, chunk, channel, 0, numChunkSamples);
+
+        previousOversampler.process (previousChunk, saturation);
+        oversamplers[currentOversampler].process (chunk, saturation);
+
+        auto numFadeSamples = juce::jmin (numChunkSamples, crossfadeSamplesRemaining);
+        auto startGain = (float) crossfadeSamplesRemaining / (float) crossfadeLength;
+        auto endGain = (float) (crossfadeSamplesRemaining - numFadeSamples) / (float) crossfadeLength;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            chunk.applyGainRamp (channel, 0, numFadeSamples, 1.0f - startGain, 1.0f - endGain);
+            chunk.addFromWithRamp (channel, 0, previousChunk.getReadPointer (channel), numFadeSamples, startGain, endGain);
+        }
+
+        crossfadeSamplesRemaining -= numFadeSamples;
+    }
+}
+
 //==============================================================================
 bool HedriteAudioProcessor::hasEditor() const
 {
@@ -174,15 +352,17 @@ juce::AudioProcessorEditor* HedriteAudioProcessor::createEditor()
 //==============================================================================
 void HedriteAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
+    juce::XmlElement state ("Hedrite");
+    state.setAttribute (oversamplingFactor->paramID, oversamplingFactor->getIndex());
+    copyXmlToBinary (state, destData);
 }
 
 void HedriteAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
+    // processBlock fades to the restored factor in the first block it renders afterwards
+    if (auto state = getXmlFromBinary (data, sizeInBytes))
+        if (state->hasTagName ("Hedrite"))
+            *oversamplingFactor = state->getIntAttribute (oversamplingFactor->paramID, oversamplingFactor->getIndex());
 }
 
 //==============================================================================
@@ -9,11 +9,17 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "NoteEventQueue.h"
+#include "Wavetable.h"
+#include "HedriteSynthesiser.h"
+#include "PartitionedConvolution.h"
+#include "Oversampling.h"
 
 //==============================================================================
 /**
 */
-class HedriteAudioProcessor  : public juce::AudioProcessor
+class HedriteAudioProcessor  : public juce::AudioProcessor,
+                               private juce::Timer
 {
 public:
     //==============================================================================
@@ -23,6 +29,7 @@ public:
     //==============================================================================
     void prepareToPlay (double sampleRate, int samplesPerBlock) override;
     void releaseResources() override;
+    void reset() override;
 
    #ifndef JucePlugin_PreferredChannelConfigurations
     bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
@@ -53,7 +60,42 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
+    // Note-ons forwarded to the editor's visuals
+    NoteEventQueue noteEvents;
+
+    // Notes beyond this many steal a voice
+    static constexpr int numVoices = 16;
+
 private:
+    //==============================================================================
+    static constexpr double impulseResponseSeconds = 2.5;
+    static constexpr float saturationDrive = 2.0f;
+    static constexpr double oversamplingCrossfadeSeconds = 0.01;
+
+    HedriteSynthesiser synth;
+    WavetableBank wavetableBank;
+    ConvolutionStage convolution;
+
+    // A change of factor starts the other oversampler at the new factor and crossfades to it, while the one in use
+    // keeps running until it has faded out
+    Oversampler oversamplers[2];
+    int currentOversampler = 0;
+    int crossfadeLength = 0;
+    int crossfadeSamplesRemaining = 0;
+    juce::AudioBuffer<float> crossfadeBuffer;
+
+    // Written by processBlock and passed on to the host by the timer, as setLatencySamples() notifies it under a lock
+    std::atomic<int> oversamplingLatency { 0 };
+
+    juce::AudioParameterChoice* oversamplingFactor;
+
+    // Runs the saturation at the current factor, fading from the previous one if a change is in progress
+    void saturate (juce::AudioBuffer<float>& buffer);
+    void timerCallback() override;
+
+    // Transport state of the previous block, for spotting playback starting
+    bool wasPlaying = false;
+
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (HedriteAudioProcessor)
 };
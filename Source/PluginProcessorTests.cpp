@@ -0,0 +1,108 @@
+#include "PluginProcessor.h"
+#include "RealtimeGuard.h"
+
+// Runs processBlock as a host's audio thread would and checks what the real-time guard saw. The guard sees every
+// allocation but only the locks that are marked, so the lock counts are checked against the marked sites each run
+// should reach: juce::Synthesiser's lock, taken once per block, and its voice stealing lock, taken once per stolen
+// voice. Anything else is a failure.
+// Run with juce::UnitTestRunner, category "Hedrite".
+class RealtimeProcessingTests : public juce::UnitTest {
+public:
+    RealtimeProcessingTests() : juce::UnitTest("Real-time processing", "Hedrite") {}
+
+    void runTest() override {
+#if HEDRITE_RT_GUARD
+        {
+            beginTest("processBlock doesn't allocate, wait or take unmarked locks");
+            HedriteAudioProcessor processor;
+            processor.prepareToPlay(sampleRate, blockSize);
+            RealtimeGuard::reset();
+
+            // Chords start and end through the run, so voices start and release inside the checked blocks. There are
+            // never more notes than voices, so nothing is stolen.
+            const int numBlocks = 64;
+            for (int block = 0; block < numBlocks; block++) {
+                processBlock(processor, [block](juce::MidiBuffer& midi) {
+                    for (int note = 0; note < 3; note++) {
+                        auto noteNumber = 48 + 3 * (block / 16) + note;
+                        if (block % 16 == 0)
+                            midi.addEvent(juce::MidiMessage::noteOn(1, noteNumber, 0.8f), 37 * note);
+                        if (block % 16 == 4)
+                            midi.addEvent(juce::MidiMessage::noteOff(1, noteNumber), 101 * note);
+                    }
+                });
+            }
+
+            expectViolations(numBlocks);
+            processor.releaseResources();
+        }
+
+        {
+            beginTest("Stealing a voice is reported");
+            HedriteAudioProcessor processor;
+            processor.prepareToPlay(sampleRate, blockSize);
+            RealtimeGuard::reset();
+
+            const int numStolen = 4;
+            processBlock(processor, [](juce::MidiBuffer& midi) {
+                for (int note = 0; note < HedriteAudioProcessor::numVoices + numStolen; note++) {
+                    midi.addEvent(juce::MidiMessage::noteOn(1, 36 + note, 0.8f), 8 * note);
+                }
+            });
+
+            expectViolations(1 + numStolen);
+            processor.releaseResources();
+        }
+
+        {
+            beginTest("Changing the oversampling factor leaves the latency report to the message thread");
+            HedriteAudioProcessor processor;
+            processor.prepareToPlay(sampleRate, blockSize);
+            auto* factor = dynamic_cast<juce::AudioParameterChoice*>(processor.getParameters().getFirst());
+            expect(factor != nullptr);
+            RealtimeGuard::reset();
+
+            if (factor != nullptr) {
+                auto latency = processor.getLatencySamples();
+                *factor = factor->getIndex() == 0 ? 1 : 0;
+                processBlock(processor, [](juce::MidiBuffer&) {});
+                processBlock(processor, [](juce::MidiBuffer&) {});
+
+                // Only the timer, on the message thread, tells the host
+                expectViolations(2);
+                expectEquals(processor.getLatencySamples(), latency, "latency reported from processBlock");
+            }
+            processor.releaseResources();
+        }
+#else
+        beginTest("processBlock doesn't allocate, wait or take unmarked locks");
+        logMessage("The real-time guard is off in this build; use a debug build or define HEDRITE_RT_GUARD=1");
+#endif
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int blockSize = 512;
+
+    template <typename MidiFiller>
+    void processBlock(HedriteAudioProcessor& processor, MidiFiller fillMidi) {
+        // Set up off the guarded thread, so only processBlock is checked
+        juce::AudioBuffer<float> buffer(processor.getTotalNumOutputChannels(), blockSize);
+        juce::MidiBuffer midi;
+        midi.ensureSize(1024);
+        fillMidi(midi);
+
+        processor.processBlock(buffer, midi);
+    }
+
+    // Nothing may allocate or wait; numLocks is how many marked lock sites the blocks should have reached
+    void expectViolations(int numLocks) {
+        logMessage(RealtimeGuard::createReport());
+        expectEquals(RealtimeGuard::getViolationCount(RealtimeGuard::allocation), 0, "allocations");
+        expectEquals(RealtimeGuard::getViolationCount(RealtimeGuard::deallocation), 0, "deallocations");
+        expectEquals(RealtimeGuard::getViolationCount(RealtimeGuard::wait), 0, "blocking waits");
+        expectEquals(RealtimeGuard::getViolationCount(RealtimeGuard::lock), numLocks, "marked locks");
+    }
+};
+
+static RealtimeProcessingTests realtimeProcessingTests;
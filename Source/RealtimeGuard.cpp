@@ -0,0 +1,244 @@
+#include "RealtimeGuard.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if JUCE_MSVC
+ #include <intrin.h>
+ #define HEDRITE_RETURN_ADDRESS _ReturnAddress()
+#else
+ #define HEDRITE_RETURN_ADDRESS __builtin_return_address(0)
+#endif
+
+#if HEDRITE_RT_GUARD
+namespace {
+    struct CallSite {
+        const void* address;
+        const char* file;
+        int line;
+        RealtimeGuard::Violation type;
+        std::atomic<int> count;
+    };
+
+    // Plain zero initialised statics, usable by operator new before any constructors have run
+    thread_local bool isAudioThreadFlag = false;
+    thread_local bool isHandlingViolation = false;
+
+    std::atomic<int> violationCounts[RealtimeGuard::numViolationTypes];
+    CallSite callSites[RealtimeGuard::maxCallSites];
+    std::atomic<int> numCallSites{ 0 };
+    std::atomic<bool> assertOnViolation{ false };
+
+    const char* const violationNames[] = { "allocation", "deallocation", "lock", "wait" };
+
+    void* allocate(std::size_t size, const void* callSite) noexcept {
+        if (isAudioThreadFlag)
+            RealtimeGuard::noteViolation(RealtimeGuard::allocation, callSite);
+
+        return std::malloc(size == 0 ? 1 : size);
+    }
+
+    void deallocate(void* pointer, const void* callSite) noexcept {
+        if (pointer != nullptr && isAudioThreadFlag)
+            RealtimeGuard::noteViolation(RealtimeGuard::deallocation, callSite);
+
+        std::free(pointer);
+    }
+}
+#endif
+
+/*
+*   ScopedAudioThread
+*/
+RealtimeGuard::ScopedAudioThread::ScopedAudioThread(bool enabled) : wasAudioThread(isAudioThread()) {
+#if HEDRITE_RT_GUARD
+    if (enabled)
+        isAudioThreadFlag = true;
+#else
+    juce::ignoreUnused(enabled);
+#endif
+}
+
+RealtimeGuard::ScopedAudioThread::~ScopedAudioThread() {
+#if HEDRITE_RT_GUARD
+    isAudioThreadFlag = wasAudioThread;
+#endif
+}
+
+/*
+*   RealtimeGuard
+*/
+bool RealtimeGuard::isAudioThread() {
+#if HEDRITE_RT_GUARD
+    return isAudioThreadFlag;
+#else
+    return false;
+#endif
+}
+
+void RealtimeGuard::setAssertOnViolation(bool shouldAssert) {
+#if HEDRITE_RT_GUARD
+    assertOnViolation = shouldAssert;
+#else
+    juce::ignoreUnused(shouldAssert);
+#endif
+}
+
+void RealtimeGuard::noteViolation(Violation type, const void* address, const char* file, int line) {
+#if HEDRITE_RT_GUARD
+    if (!isAudioThreadFlag || isHandlingViolation)
+        return;
+
+    // Whatever the assertion below allocates mustn't be reported again
+    isHandlingViolation = true;
+    violationCounts[type]++;
+
+    auto numSites = jmin(numCallSites.load(), maxCallSites);
+    bool isKnownSite = false;
+
+    for (int i = 0; i < numSites && !isKnownSite; i++) {
+        auto& site = callSites[i];
+        if (site.type == type && site.address == address && site.file == file && site.line == line) {
+            site.count++;
+            isKnownSite = true;
+        }
+    }
+
+    // Sites past the end of the table are still counted, just not located
+    if (!isKnownSite) {
+        auto index = numCallSites++;
+        if (index < maxCallSites) {
+            auto& site = callSites[index];
+            site.address = address;
+            site.file = file;
+            site.line = line;
+            site.type = type;
+            site.count = 1;
+        }
+    }
+
+    if (assertOnViolation) {
+        jassertfalse;
+    }
+    isHandlingViolation = false;
+#else
+    juce::ignoreUnused(type, address, file, line);
+#endif
+}
+
+int RealtimeGuard::getViolationCount(Violation type) {
+#if HEDRITE_RT_GUARD
+    return violationCounts[type].load();
+#else
+    juce::ignoreUnused(type);
+    return 0;
+#endif
+}
+
+int RealtimeGuard::getTotalViolationCount() {
+    int total = 0;
+    for (int type = 0; type < numViolationTypes; type++) {
+        total += getViolationCount((Violation)type);
+    }
+    return total;
+}
+
+juce::String RealtimeGuard::createReport() {
+#if HEDRITE_RT_GUARD
+    juce::StringArray counts;
+    for (int type = 0; type < numViolationTypes; type++) {
+        counts.add(juce::String(getViolationCount((Violation)type)) + " " + violationNames[type] + "s");
+    }
+
+    juce::String report = "--- Real-time guard: " + counts.joinIntoString(", ") + " on the audio thread ---";
+
+    auto numRecordedSites = numCallSites.load();
+    for (int i = 0; i < jmin(numRecordedSites, maxCallSites); i++) {
+        auto& site = callSites[i];
+        auto location = site.file != nullptr
+            ? juce::File::createFileWithoutCheckingPath(site.file).getFileName() + ":" + juce::String(site.line)
+            : "0x" + juce::String::toHexString((juce::pointer_sized_int)site.address);
+
+        report << juce::newLine << "    " << violationNames[site.type] << " x" << site.count.load() << " at " << location;
+    }
+    if (numRecordedSites > maxCallSites) {
+        report << juce::newLine << "    " << (numRecordedSites - maxCallSites) << " more sites not recorded";
+    }
+
+    return report;
+#else
+    return "--- Real-time guard disabled ---";
+#endif
+}
+
+void RealtimeGuard::reset() {
+#if HEDRITE_RT_GUARD
+    for (auto& count : violationCounts) {
+        count = 0;
+    }
+    numCallSites = 0;
+#endif
+}
+
+/*
+*   CheckedCriticalSection
+*/
+void RealtimeGuard::CheckedCriticalSection::enter() const noexcept {
+#if HEDRITE_RT_GUARD
+    if (isAudioThreadFlag)
+        noteViolation(RealtimeGuard::lock, HEDRITE_RETURN_ADDRESS);
+#endif
+    juce::CriticalSection::enter();
+}
+
+/*
+*   Global allocation functions
+*
+*   Only the plain and nothrow forms are replaced; the aligned forms keep the library's own, matching pair.
+*   malloc and free can't be replaced portably (MSVC doesn't allow it at all), so direct C allocations aren't seen.
+*/
+#if HEDRITE_RT_GUARD
+void* operator new(std::size_t size) {
+    if (auto* pointer = allocate(size, HEDRITE_RETURN_ADDRESS))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    if (auto* pointer = allocate(size, HEDRITE_RETURN_ADDRESS))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size, HEDRITE_RETURN_ADDRESS);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size, HEDRITE_RETURN_ADDRESS);
+}
+
+void operator delete(void* pointer) noexcept {
+    deallocate(pointer, HEDRITE_RETURN_ADDRESS);
+}
+
+void operator delete[](void* pointer) noexcept {
+    deallocate(pointer, HEDRITE_RETURN_ADDRESS);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    deallocate(pointer, HEDRITE_RETURN_ADDRESS);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+    deallocate(pointer, HEDRITE_RETURN_ADDRESS);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    deallocate(pointer, HEDRITE_RETURN_ADDRESS);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    deallocate(pointer, HEDRITE_RETURN_ADDRESS);
+}
+#endif
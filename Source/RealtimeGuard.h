@@ -0,0 +1,75 @@
+#pragma once
+#include <JuceHeader.h>
+
+// On in debug builds; test builds can force it with HEDRITE_RT_GUARD=1
+#ifndef HEDRITE_RT_GUARD
+ #if JUCE_DEBUG
+  #define HEDRITE_RT_GUARD 1
+ #else
+  #define HEDRITE_RT_GUARD 0
+ #endif
+#endif
+
+// Records allocations, and marked locks and blocking waits, made while a thread is marked as the audio thread.
+// Every allocation is seen, through replacements of the global operator new and delete. Locks and waits are not
+// intercepted: only CheckedCriticalSection and the calls marked with HEDRITE_RT_LOCKING_CALL or HEDRITE_RT_BLOCKING_CALL
+// are seen, and a lock or wait inside library code goes unnoticed unless the call that takes it is marked. Each kind
+// is counted and the places they happened are kept in a fixed table, so recording never allocates. With the guard off
+// everything here compiles to nothing.
+namespace RealtimeGuard {
+	enum Violation {
+		allocation,
+		deallocation,
+		lock,
+		wait,
+		numViolationTypes
+	};
+
+	static constexpr int maxCallSites = 64;
+
+	// Marks the calling thread as the audio thread until it goes out of scope
+	class ScopedAudioThread {
+	public:
+		explicit ScopedAudioThread(bool enabled = true);
+		~ScopedAudioThread();
+
+	private:
+		bool wasAudioThread;
+
+		JUCE_DECLARE_NON_COPYABLE(ScopedAudioThread)
+	};
+
+	bool isAudioThread();
+
+	// Off by default so a debug session can run on and read the report afterwards
+	void setAssertOnViolation(bool shouldAssert);
+
+	// Either a code address (for allocations and locks) or a source location (for blocking calls) identifies the site
+	void noteViolation(Violation type, const void* address, const char* file = nullptr, int line = 0);
+
+	int getViolationCount(Violation type);
+	int getTotalViolationCount();
+
+	// Counts and call sites since the last reset; only call while the audio thread is stopped
+	juce::String createReport();
+	void reset();
+
+	// A CriticalSection that reports being entered on the audio thread. tryEnter() never blocks, so it isn't reported.
+	class CheckedCriticalSection : public juce::CriticalSection {
+	public:
+		void enter() const noexcept;
+
+		using ScopedLockType = juce::GenericScopedLock<CheckedCriticalSection>;
+	};
+
+	using ScopedLock = CheckedCriticalSection::ScopedLockType;
+}
+
+// Place directly before a call that can block, such as waiting on an event, or one that takes a lock internally
+#if HEDRITE_RT_GUARD
+ #define HEDRITE_RT_BLOCKING_CALL() RealtimeGuard::noteViolation (RealtimeGuard::wait, nullptr, __FILE__, __LINE__)
+ #define HEDRITE_RT_LOCKING_CALL() RealtimeGuard::noteViolation (RealtimeGuard::lock, nullptr, __FILE__, __LINE__)
+#else
+ #define HEDRITE_RT_BLOCKING_CALL()
+ #define HEDRITE_RT_LOCKING_CALL()
+#endif
@@ -0,0 +1,469 @@
+#include "SoftwareRenderer.h"
+#include <atomic>
+#include <thread>
+
+#if JUCE_INTEL
+ #include <xmmintrin.h>
+#endif
+
+namespace {
+    // Pulls lines slightly in front of the faces they outline, in place of the z-fighting the GL path gets
+    const float lineDepthBias = 1.0e-4f;
+
+    template <typename Vertex>
+    Vertex interpolateVertex(const Vertex& a, const Vertex& b, float t) {
+        return { a.x + t * (b.x - a.x), a.y + t * (b.y - a.y), a.z + t * (b.z - a.z), a.w + t * (b.w - a.w),
+                 a.red + t * (b.red - a.red), a.green + t * (b.green - a.green), a.blue + t * (b.blue - a.blue) };
+    }
+
+    // Same facing as GL's counter-clockwise front faces, worked out before the divide so it also holds for clipped triangles
+    template <typename Vertex>
+    bool isFrontFacing(const Vertex& a, const Vertex& b, const Vertex& c) {
+        return a.x * (b.y * c.w - b.w * c.y) - a.y * (b.x * c.w - b.w * c.x) + a.w * (b.x * c.y - b.y * c.x) > 0.0f;
+    }
+
+    // Liang-Barsky: the parameter range of start + t * delta, t in [0, 1], that lies inside the rectangle
+    bool clipSegment(float x, float y, float dx, float dy, float left, float top, float right, float bottom, float& t0, float& t1) {
+        const float p[4] = { -dx, dx, -dy, dy };
+        const float q[4] = { x - left, right - x, y - top, bottom - y };
+        t0 = 0.0f;
+        t1 = 1.0f;
+
+        for (int k = 0; k < 4; k++) {
+            if (p[k] == 0.0f) {
+                if (q[k] < 0.0f)
+                    return false;
+            }
+            else {
+                auto t = q[k] / p[k];
+                if (p[k] < 0.0f)
+                    t0 = jmax(t0, t);
+                else
+                    t1 = jmin(t1, t);
+            }
+        }
+        return t0 <= t1;
+    }
+
+    juce::uint8 toByte(float value) {
+        return (juce::uint8)jlimit(0, 255, roundToInt(value * 255.0f));
+    }
+}
+
+juce::Image SoftwareRenderer::render(const std::vector<OpenGLWindow::Shape>& shapes, const Matrix3D<float>& projectionMatrix,
+    const Matrix3D<float>& viewMatrix, const Vector3D<float>& lightPosition, int newWidth, int newHeight) {
+    if (newWidth <= 0 || newHeight <= 0)
+        return {};
+
+    width = newWidth;
+    height = newHeight;
+    numTilesX = (width + tileSize - 1) / tileSize;
+    numTilesY = (height + tileSize - 1) / tileSize;
+    triangles.clear();
+    lines.clear();
+
+    auto viewProjection = multiplyMatrices(projectionMatrix, viewMatrix);
+    const float* m = viewProjection.mat;
+
+    // Same lighting as the shader: the dot product of the normalised normal and light direction
+    auto lightLength = jmax(1.0e-12f, std::sqrt(lightPosition.x * lightPosition.x + lightPosition.y * lightPosition.y + lightPosition.z * lightPosition.z));
+    const float light[3] = { lightPosition.x / lightLength, lightPosition.y / lightLength, lightPosition.z / lightLength };
+
+    for (auto& shape : shapes) {
+        fillVertices.resize((size_t)shape.vertices.size());
+        lineVertices.resize((size_t)shape.vertices.size());
+
+        for (int v = 0; v < shape.vertices.size(); v++) {
+            auto& vertex = shape.vertices.getReference(v);
+            auto* p = vertex.position;
+            auto* n = vertex.normal;
+
+            auto normalLength = jmax(1.0e-12f, std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]));
+            auto lambert = (n[0] * light[0] + n[1] * light[1] + n[2] * light[2]) / normalLength;
+            auto shade = jmin(1.0f, 0.5f + jmax(lambert, 0.0f));
+
+            auto& fill = fillVertices[(size_t)v];
+            fill.x = m[0] * p[0] + m[4] * p[1] + m[8] * p[2] + m[12];
+            fill.y = m[1] * p[0] + m[5] * p[1] + m[9] * p[2] + m[13];
+            fill.z = m[2] * p[0] + m[6] * p[1] + m[10] * p[2] + m[14];
+            fill.w = m[3] * p[0] + m[7] * p[1] + m[11] * p[2] + m[15];
+            fill.red = vertex.colour[0] * shade;
+            fill.green = vertex.colour[1] * shade;
+            fill.blue = vertex.colour[2] * shade;
+
+            auto& line = lineVertices[(size_t)v];
+            line = fill;
+            if (shape.hasWireframe) {
+                line.red = shape.wireframeColour.getFloatRed() * shade;
+                line.green = shape.wireframeColour.getFloatGreen() * shade;
+                line.blue = shape.wireframeColour.getFloatBlue() * shade;
+            }
+        }
+
+        for (size_t i = 0; i + 2 < shape.indices.size(); i += 3) {
+            addTriangle(fillVertices[shape.indices[i]], fillVertices[shape.indices[i + 1]], fillVertices[shape.indices[i + 2]]);
+        }
+
+        if (!shape.edges.empty()) {
+            for (size_t i = 0; i + 1 < shape.edges.size(); i += 2) {
+                addLine(lineVertices[shape.edges[i]], lineVertices[shape.edges[i + 1]]);
+            }
+        }
+        else {
+            // Without extracted edges the GL path outlines the front faces instead
+            for (size_t i = 0; i + 2 < shape.indices.size(); i += 3) {
+                if (!isFrontFacing(fillVertices[shape.indices[i]], fillVertices[shape.indices[i + 1]], fillVertices[shape.indices[i + 2]]))
+                    continue;
+
+                for (size_t k = 0; k < 3; k++) {
+                    addLine(lineVertices[shape.indices[i + k]], lineVertices[shape.indices[i + (k + 1) % 3]]);
+                }
+            }
+        }
+    }
+
+    binPrimitives();
+
+    // Transparent black, the same as the GL clear
+    juce::Image image(juce::Image::ARGB, width, height, true, juce::SoftwareImageType());
+    {
+        juce::Image::BitmapData pixels(image, juce::Image::BitmapData::readWrite);
+        auto numTiles = numTilesX * numTilesY;
+        std::atomic<int> nextTile{ 0 };
+
+        // Tiles cover disjoint pixels, so each thread only needs its own depth buffer
+        auto rasteriseTiles = [&] {
+            std::vector<float> depthBuffer(tileSize * tileSize + 4);
+            for (int tile = nextTile++; tile < numTiles; tile = nextTile++) {
+                rasteriseTile(tile, pixels, depthBuffer.data());
+            }
+        };
+
+        auto numThreads = jlimit(1, jmax(1, juce::SystemStats::getNumCpus()), numTiles);
+        std::vector<std::thread> threads;
+
+        for (int t = 1; t < numThreads; t++) {
+            threads.emplace_back(rasteriseTiles);
+        }
+        rasteriseTiles();
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    return image;
+}
+
+void SoftwareRenderer::addTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c) {
+    // Clip against the near plane, z >= -w; the far plane is left to the depth test
+    const ClipVertex input[3] = { a, b, c };
+    ClipVertex output[4];
+    int numOutput = 0;
+
+    for (int i = 0; i < 3; i++) {
+        auto& current = input[i];
+        auto& next = input[(i + 1) % 3];
+        auto currentDistance = current.z + current.w;
+        auto nextDistance = next.z + next.w;
+
+        if (currentDistance >= 0.0f)
+            output[numOutput++] = current;
+
+        if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f))
+            output[numOutput++] = interpolateVertex(current, next, currentDistance / (currentDistance - nextDistance));
+    }
+
+    for (int i = 1; i + 1 < numOutput; i++) {
+        setupTriangle(output[0], output[i], output[i + 1]);
+    }
+}
+
+void SoftwareRenderer::setupTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c) {
+    const ClipVertex* vertices[3] = { &a, &b, &c };
+    float x[3], y[3], depth[3], inverseW[3], red[3], green[3], blue[3];
+
+    for (int i = 0; i < 3; i++) {
+        auto& v = *vertices[i];
+        inverseW[i] = 1.0f / v.w;
+        x[i] = (v.x * inverseW[i] * 0.5f + 0.5f) * (float)width;
+        y[i] = (0.5f - v.y * inverseW[i] * 0.5f) * (float)height;
+        depth[i] = v.z * inverseW[i] * 0.5f + 0.5f;
+
+        // Colours are interpolated as colour / w to be perspective correct
+        red[i] = v.red * inverseW[i];
+        green[i] = v.green * inverseW[i];
+        blue[i] = v.blue * inverseW[i];
+    }
+
+    // Counter-clockwise front faces in GL turn clockwise once y points down the image
+    auto area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+    if (!(area < 0.0f))
+        return;
+
+    // Reverse the winding so every edge function is positive inside
+    for (auto* attribute : { x, y, depth, inverseW, red, green, blue }) {
+        std::swap(attribute[1], attribute[2]);
+    }
+    area = -area;
+
+    Triangle triangle;
+    for (int k = 0; k < 3; k++) {
+        auto from = (k + 1) % 3, to = (k + 2) % 3;
+        triangle.edgeA[k] = y[from] - y[to];
+        triangle.edgeB[k] = x[to] - x[from];
+        triangle.edgeC[k] = x[from] * y[to] - x[to] * y[from];
+
+        // Pixels exactly on a shared edge belong to the triangle to its right or below
+        triangle.isTopLeft[k] = triangle.edgeA[k] > 0.0f || (triangle.edgeA[k] == 0.0f && triangle.edgeB[k] > 0.0f);
+    }
+
+    // Edge function k over the area is the barycentric weight of vertex k
+    auto makePlane = [&triangle, area](const float* values) {
+        Plane plane{ 0.0f, 0.0f, 0.0f };
+        for (int k = 0; k < 3; k++) {
+            plane.dx += triangle.edgeA[k] * values[k];
+            plane.dy += triangle.edgeB[k] * values[k];
+            plane.c += triangle.edgeC[k] * values[k];
+        }
+        plane.dx /= area;
+        plane.dy /= area;
+        plane.c /= area;
+        return plane;
+    };
+
+    triangle.depth = makePlane(depth);
+    triangle.inverseW = makePlane(inverseW);
+    triangle.red = makePlane(red);
+    triangle.green = makePlane(green);
+    triangle.blue = makePlane(blue);
+
+    triangle.minX = jmax(0, (int)std::floor(jmin(x[0], x[1], x[2])));
+    triangle.minY = jmax(0, (int)std::floor(jmin(y[0], y[1], y[2])));
+    triangle.maxX = jmin(width - 1, (int)std::ceil(jmax(x[0], x[1], x[2])));
+    triangle.maxY = jmin(height - 1, (int)std::ceil(jmax(y[0], y[1], y[2])));
+
+    if (triangle.minX <= triangle.maxX && triangle.minY <= triangle.maxY)
+        triangles.push_back(triangle);
+}
+
+void SoftwareRenderer::addLine(ClipVertex a, ClipVertex b) {
+    auto distanceA = a.z + a.w, distanceB = b.z + b.w;
+    if (distanceA < 0.0f && distanceB < 0.0f)
+        return;
+
+    if (distanceA < 0.0f)
+        a = interpolateVertex(a, b, distanceA / (distanceA - distanceB));
+    else if (distanceB < 0.0f)
+        b = interpolateVertex(b, a, distanceB / (distanceB - distanceA));
+
+    Line line;
+    line.inverseW0 = 1.0f / a.w;
+    line.inverseW1 = 1.0f / b.w;
+    line.x0 = (a.x * line.inverseW0 * 0.5f + 0.5f) * (float)width;
+    line.y0 = (0.5f - a.y * line.inverseW0 * 0.5f) * (float)height;
+    line.x1 = (b.x * line.inverseW1 * 0.5f + 0.5f) * (float)width;
+    line.y1 = (0.5f - b.y * line.inverseW1 * 0.5f) * (float)height;
+    line.depth0 = a.z * line.inverseW0 * 0.5f + 0.5f;
+    line.depth1 = b.z * line.inverseW1 * 0.5f + 0.5f;
+    line.colour0[0] = a.red * line.inverseW0;
+    line.colour0[1] = a.green * line.inverseW0;
+    line.colour0[2] = a.blue * line.inverseW0;
+    line.colour1[0] = b.red * line.inverseW1;
+    line.colour1[1] = b.green * line.inverseW1;
+    line.colour1[2] = b.blue * line.inverseW1;
+
+    // Trim to the image so the step count stays bounded; everything stored is linear in screen space
+    float t0, t1;
+    if (!clipSegment(line.x0, line.y0, line.x1 - line.x0, line.y1 - line.y0, -1.0f, -1.0f, (float)width + 1.0f, (float)height + 1.0f, t0, t1))
+        return;
+
+    auto trim = [t0, t1](float& start, float& end) {
+        auto delta = end - start;
+        end = start + t1 * delta;
+        start = start + t0 * delta;
+    };
+    trim(line.x0, line.x1);
+    trim(line.y0, line.y1);
+    trim(line.depth0, line.depth1);
+    trim(line.inverseW0, line.inverseW1);
+    for (int i = 0; i < 3; i++) {
+        trim(line.colour0[i], line.colour1[i]);
+    }
+
+    line.numSteps = jmax(1, (int)std::ceil(jmax(std::abs(line.x1 - line.x0), std::abs(line.y1 - line.y0))));
+    line.minX = jmax(0, (int)std::floor(jmin(line.x0, line.x1)));
+    line.minY = jmax(0, (int)std::floor(jmin(line.y0, line.y1)));
+    line.maxX = jmin(width - 1, (int)std::floor(jmax(line.x0, line.x1)));
+    line.maxY = jmin(height - 1, (int)std::floor(jmax(line.y0, line.y1)));
+
+    if (line.minX <= line.maxX && line.minY <= line.maxY)
+        lines.push_back(line);
+}
+
+void SoftwareRenderer::binPrimitives() {
+    auto numTiles = (size_t)(numTilesX * numTilesY);
+    triangleBins.resize(numTiles);
+    lineBins.resize(numTiles);
+
+    // Clearing rather than reallocating keeps each bin's capacity between frames
+    for (size_t i = 0; i < numTiles; i++) {
+        triangleBins[i].clear();
+        lineBins[i].clear();
+    }
+
+    auto binBounds = [this](std::vector<std::vector<int>>& bins, int index, int minX, int minY, int maxX, int maxY) {
+        for (int tileY = minY / tileSize; tileY <= maxY / tileSize; tileY++) {
+            for (int tileX = minX / tileSize; tileX <= maxX / tileSize; tileX++) {
+                bins[(size_t)(tileY * numTilesX + tileX)].push_back(index);
+            }
+        }
+    };
+
+    for (int i = 0; i < (int)triangles.size(); i++) {
+        auto& triangle = triangles[(size_t)i];
+        binBounds(triangleBins, i, triangle.minX, triangle.minY, triangle.maxX, triangle.maxY);
+    }
+    for (int i = 0; i < (int)lines.size(); i++) {
+        auto& line = lines[(size_t)i];
+        binBounds(lineBins, i, line.minX, line.minY, line.maxX, line.maxY);
+    }
+}
+
+void SoftwareRenderer::rasteriseTile(int tileIndex, juce::Image::BitmapData& pixels, float* depthBuffer) const {
+    auto& tileTriangles = triangleBins[(size_t)tileIndex];
+    auto& tileLines = lineBins[(size_t)tileIndex];
+    if (tileTriangles.empty() && tileLines.empty())
+        return;
+
+    auto tileX = (tileIndex % numTilesX) * tileSize;
+    auto tileY = (tileIndex / numTilesX) * tileSize;
+    auto tileRight = jmin(tileX + tileSize, width);
+    auto tileBottom = jmin(tileY + tileSize, height);
+
+    std::fill(depthBuffer, depthBuffer + tileSize * tileSize, 1.0f);
+
+    // Same order as the GL path: every face first, then the wireframe over them
+    for (auto index : tileTriangles) {
+        fillTriangle(triangles[(size_t)index], tileX, tileY, tileRight, tileBottom, pixels, depthBuffer);
+    }
+    for (auto index : tileLines) {
+        drawLine(lines[(size_t)index], tileX, tileY, tileRight, tileBottom, pixels, depthBuffer);
+    }
+}
+
+void SoftwareRenderer::fillTriangle(const Triangle& triangle, int tileX, int tileY, int tileRight, int tileBottom,
+    juce::Image::BitmapData& pixels, float* depthBuffer) const {
+    auto startX = jmax(tileX, triangle.minX);
+    auto endX = jmin(tileRight - 1, triangle.maxX);
+    auto startY = jmax(tileY, triangle.minY);
+    auto endY = jmin(tileBottom - 1, triangle.maxY);
+
+    for (int y = startY; y <= endY; y++) {
+        auto py = (float)y + 0.5f;
+        auto* row = reinterpret_cast<juce::PixelARGB*>(pixels.getLinePointer(y));
+        auto* depthRow = depthBuffer + (y - tileY) * tileSize - tileX;
+
+        float rowEdge[3];
+        for (int k = 0; k < 3; k++) {
+            rowEdge[k] = triangle.edgeB[k] * py + triangle.edgeC[k];
+        }
+
+#if JUCE_INTEL
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 allSet = _mm_cmpeq_ps(zero, zero);
+        const __m128 laneCentres = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        const __m128 spanEnd = _mm_set1_ps((float)(endX + 1));
+
+        // The depth buffer has a few floats of padding, so the last group of a row can read past its end
+        for (int x = startX; x <= endX; x += 4) {
+            __m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneCentres);
+            __m128 inside = _mm_cmplt_ps(px, spanEnd);
+
+            for (int k = 0; k < 3; k++) {
+                __m128 edge = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edgeA[k]), px), _mm_set1_ps(rowEdge[k]));
+                __m128 onEdge = _mm_and_ps(_mm_cmpeq_ps(edge, zero), triangle.isTopLeft[k] ? allSet : zero);
+                inside = _mm_and_ps(inside, _mm_or_ps(_mm_cmpgt_ps(edge, zero), onEdge));
+            }
+            if (_mm_movemask_ps(inside) == 0)
+                continue;
+
+            __m128 depth = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.depth.dx), px), _mm_set1_ps(triangle.depth.dy * py + triangle.depth.c));
+            __m128 storedDepth = _mm_loadu_ps(depthRow + x);
+            inside = _mm_and_ps(inside, _mm_cmplt_ps(depth, storedDepth));
+
+            auto mask = _mm_movemask_ps(inside);
+            if (mask == 0)
+                continue;
+
+            _mm_storeu_ps(depthRow + x, _mm_or_ps(_mm_and_ps(inside, depth), _mm_andnot_ps(inside, storedDepth)));
+
+            __m128 inverseW = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.inverseW.dx), px), _mm_set1_ps(triangle.inverseW.dy * py + triangle.inverseW.c));
+            __m128 w = _mm_div_ps(_mm_set1_ps(1.0f), inverseW);
+
+            float red[4], green[4], blue[4];
+            _mm_storeu_ps(red, _mm_mul_ps(w, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.red.dx), px), _mm_set1_ps(triangle.red.dy * py + triangle.red.c))));
+            _mm_storeu_ps(green, _mm_mul_ps(w, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.green.dx), px), _mm_set1_ps(triangle.green.dy * py + triangle.green.c))));
+            _mm_storeu_ps(blue, _mm_mul_ps(w, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.blue.dx), px), _mm_set1_ps(triangle.blue.dy * py + triangle.blue.c))));
+
+            for (int lane = 0; lane < 4; lane++) {
+                if (mask & (1 << lane))
+                    row[x + lane].setARGB(255, toByte(red[lane]), toByte(green[lane]), toByte(blue[lane]));
+            }
+        }
+#else
+        for (int x = startX; x <= endX; x++) {
+            auto px = (float)x + 0.5f;
+            bool inside = true;
+
+            for (int k = 0; k < 3 && inside; k++) {
+                auto edge = triangle.edgeA[k] * px + rowEdge[k];
+                inside = edge > 0.0f || (edge == 0.0f && triangle.isTopLeft[k]);
+            }
+            if (!inside)
+                continue;
+
+            auto depth = triangle.depth.at(px, py);
+            if (!(depth < depthRow[x]))
+                continue;
+            depthRow[x] = depth;
+
+            auto w = 1.0f / triangle.inverseW.at(px, py);
+            row[x].setARGB(255, toByte(triangle.red.at(px, py) * w), toByte(triangle.green.at(px, py) * w), toByte(triangle.blue.at(px, py) * w));
+        }
+#endif
+    }
+}
+
+void SoftwareRenderer::drawLine(const Line& line, int tileX, int tileY, int tileRight, int tileBottom,
+    juce::Image::BitmapData& pixels, float* depthBuffer) const {
+    auto dx = line.x1 - line.x0;
+    auto dy = line.y1 - line.y0;
+
+    // Only walk the steps that can land in this tile, keeping the same step positions as in every other tile
+    float t0, t1;
+    if (!clipSegment(line.x0, line.y0, dx, dy, (float)tileX - 1.0f, (float)tileY - 1.0f, (float)tileRight + 1.0f, (float)tileBottom + 1.0f, t0, t1))
+        return;
+
+    auto firstStep = jmax(0, (int)std::floor(t0 * (float)line.numSteps));
+    auto lastStep = jmin(line.numSteps, (int)std::ceil(t1 * (float)line.numSteps));
+
+    for (int step = firstStep; step <= lastStep; step++) {
+        auto t = (float)step / (float)line.numSteps;
+        auto x = (int)std::floor(line.x0 + t * dx);
+        auto y = (int)std::floor(line.y0 + t * dy);
+        if (x < tileX || x >= tileRight || y < tileY || y >= tileBottom)
+            continue;
+
+        auto& storedDepth = depthBuffer[(y - tileY) * tileSize + x - tileX];
+        auto depth = line.depth0 + t * (line.depth1 - line.depth0);
+        if (!(depth - lineDepthBias < storedDepth))
+            continue;
+        storedDepth = depth;
+
+        auto w = 1.0f / (line.inverseW0 + t * (line.inverseW1 - line.inverseW0));
+        auto colour = [&line, t, w](int i) { return toByte((line.colour0[i] + t * (line.colour1[i] - line.colour0[i])) * w); };
+
+        reinterpret_cast<juce::PixelARGB*>(pixels.getLinePointer(y))[x].setARGB(255, colour(0), colour(1), colour(2));
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <JuceHeader.h>
+#include <vector>
+#include "OpenGLWindow.h"
+
+// CPU rasteriser for the shapes drawn by OpenGLWindow, for thumbnails, previews and exported frames on machines without
+// usable OpenGL. Lighting, culling, depth testing and the wireframe pass match the shaders in OpenGLWindow::createShaders.
+// Triangles and lines are binned into tiles, and the tiles are rasterised in parallel with four pixel edge function tests.
+// Keep one renderer around when drawing many frames so its buffers are reused.
+class SoftwareRenderer {
+public:
+	static constexpr int tileSize = 32;
+
+	juce::Image render(const std::vector<OpenGLWindow::Shape>& shapes, const Matrix3D<float>& projectionMatrix,
+		const Matrix3D<float>& viewMatrix, const Vector3D<float>& lightPosition, int width, int height);
+
+private:
+	struct ClipVertex {
+		float x, y, z, w;
+		float red, green, blue;
+	};
+
+	// Attribute as a linear function of the pixel position
+	struct Plane {
+		float dx, dy, c;
+		float at(float x, float y) const { return dx * x + dy * y + c; }
+	};
+
+	struct Triangle {
+		float edgeA[3], edgeB[3], edgeC[3];
+		bool isTopLeft[3];
+		Plane depth, inverseW, red, green, blue;
+		int minX, minY, maxX, maxY;
+	};
+
+	struct Line {
+		float x0, y0, x1, y1;
+		float depth0, depth1;
+		float inverseW0, inverseW1;
+		float colour0[3], colour1[3];
+		int numSteps;
+		int minX, minY, maxX, maxY;
+	};
+
+	void addTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c);
+	void addLine(ClipVertex a, ClipVertex b);
+	void setupTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c);
+	void binPrimitives();
+
+	void rasteriseTile(int tileIndex, juce::Image::BitmapData& pixels, float* depthBuffer) const;
+	void fillTriangle(const Triangle& triangle, int tileX, int tileY, int tileRight, int tileBottom,
+		juce::Image::BitmapData& pixels, float* depthBuffer) const;
+	void drawLine(const Line& line, int tileX, int tileY, int tileRight, int tileBottom,
+		juce::Image::BitmapData& pixels, float* depthBuffer) const;
+
+	int width = 0, height = 0;
+	int numTilesX = 0, numTilesY = 0;
+
+	std::vector<ClipVertex> fillVertices, lineVertices;
+	std::vector<Triangle> triangles;
+	std::vector<Line> lines;
+	std::vector<std::vector<int>> triangleBins, lineBins;
+};
@@ -0,0 +1,187 @@
+#include "VectorMath.h"
+
+#if JUCE_INTEL
+ #include <xmmintrin.h>
+#endif
+
+namespace {
+    // Smallest squared length a normal may have before it's left unnormalised
+    const float minNormalLengthSquared = 1.0e-24f;
+
+    // Upper 3x3 of the matrix applied to v, without translation
+    inline void rotateScalar(const float* m, float x, float y, float z, float& outX, float& outY, float& outZ) {
+        outX = m[0] * x + m[4] * y + m[8] * z;
+        outY = m[1] * x + m[5] * y + m[9] * z;
+        outZ = m[2] * x + m[6] * y + m[10] * z;
+    }
+}
+
+juce::Matrix3D<float> multiplyMatrices(const juce::Matrix3D<float>& a, const juce::Matrix3D<float>& b) {
+    juce::Matrix3D<float> result;
+
+#if JUCE_INTEL
+    __m128 columns[4] = { _mm_loadu_ps(a.mat), _mm_loadu_ps(a.mat + 4), _mm_loadu_ps(a.mat + 8), _mm_loadu_ps(a.mat + 12) };
+
+    // Column j of the result is a times column j of b
+    for (int j = 0; j < 4; j++) {
+        __m128 column = _mm_mul_ps(columns[0], _mm_set1_ps(b.mat[4 * j]));
+        column = _mm_add_ps(column, _mm_mul_ps(columns[1], _mm_set1_ps(b.mat[4 * j + 1])));
+        column = _mm_add_ps(column, _mm_mul_ps(columns[2], _mm_set1_ps(b.mat[4 * j + 2])));
+        column = _mm_add_ps(column, _mm_mul_ps(columns[3], _mm_set1_ps(b.mat[4 * j + 3])));
+        _mm_storeu_ps(result.mat + 4 * j, column);
+    }
+#else
+    for (int j = 0; j < 4; j++) {
+        for (int i = 0; i < 4; i++) {
+            result.mat[4 * j + i] = a.mat[i] * b.mat[4 * j] + a.mat[4 + i] * b.mat[4 * j + 1]
+                + a.mat[8 + i] * b.mat[4 * j + 2] + a.mat[12 + i] * b.mat[4 * j + 3];
+        }
+    }
+#endif
+    return result;
+}
+
+juce::Matrix3D<float> transposeMatrix(const juce::Matrix3D<float>& matrix) {
+    juce::Matrix3D<float> result;
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            result.mat[4 * i + j] = matrix.mat[4 * j + i];
+        }
+    }
+    return result;
+}
+
+juce::Matrix3D<float> invertMatrix(const juce::Matrix3D<float>& matrix) {
+    // Cofactor expansion; the inverse of the transpose is the transpose of the inverse, so this doesn't depend on the layout
+    const float* m = matrix.mat;
+    float inv[16];
+
+    inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+    inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+    inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+    inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+    inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+    inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+    inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+    inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+    inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+    inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+    inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+    inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+    inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+    inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+    inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+    inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+    float determinant = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+
+    if (determinant == 0.0f) {
+        jassertfalse;
+        return juce::Matrix3D<float>();
+    }
+
+    juce::Matrix3D<float> result;
+    float inverseDeterminant = 1.0f / determinant;
+    for (int i = 0; i < 16; i++) {
+        result.mat[i] = inv[i] * inverseDeterminant;
+    }
+    return result;
+}
+
+juce::Vector3D<float> applyTransformationMatrix(const juce::Matrix3D<float>& matrix, const juce::Vector3D<float>& point) {
+    juce::Vector3D<float> result;
+    rotateScalar(matrix.mat, point.x, point.y, point.z, result.x, result.y, result.z);
+    result.x += matrix.mat[12];
+    result.y += matrix.mat[13];
+    result.z += matrix.mat[14];
+    return result;
+}
+
+juce::Vector3D<float> applyDirectionMatrix(const juce::Matrix3D<float>& matrix, const juce::Vector3D<float>& direction) {
+    juce::Vector3D<float> result;
+    rotateScalar(matrix.mat, direction.x, direction.y, direction.z, result.x, result.y, result.z);
+    return result;
+}
+
+void transformPoints(const juce::Matrix3D<float>& matrix, const float* x, const float* y, const float* z,
+    float* outX, float* outY, float* outZ, int num) {
+    const float* m = matrix.mat;
+    int i = 0;
+
+#if JUCE_INTEL
+    // One pass over the data, four points per iteration; at 24 bytes of traffic per point this is bound by memory bandwidth
+    const __m128 m0 = _mm_set1_ps(m[0]), m1 = _mm_set1_ps(m[1]), m2 = _mm_set1_ps(m[2]);
+    const __m128 m4 = _mm_set1_ps(m[4]), m5 = _mm_set1_ps(m[5]), m6 = _mm_set1_ps(m[6]);
+    const __m128 m8 = _mm_set1_ps(m[8]), m9 = _mm_set1_ps(m[9]), m10 = _mm_set1_ps(m[10]);
+    const __m128 m12 = _mm_set1_ps(m[12]), m13 = _mm_set1_ps(m[13]), m14 = _mm_set1_ps(m[14]);
+
+    for (; i + 4 <= num; i += 4) {
+        __m128 px = _mm_loadu_ps(x + i);
+        __m128 py = _mm_loadu_ps(y + i);
+        __m128 pz = _mm_loadu_ps(z + i);
+
+        __m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, px), _mm_mul_ps(m4, py)), _mm_add_ps(_mm_mul_ps(m8, pz), m12));
+        __m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m1, px), _mm_mul_ps(m5, py)), _mm_add_ps(_mm_mul_ps(m9, pz), m13));
+        __m128 rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m2, px), _mm_mul_ps(m6, py)), _mm_add_ps(_mm_mul_ps(m10, pz), m14));
+
+        _mm_storeu_ps(outX + i, rx);
+        _mm_storeu_ps(outY + i, ry);
+        _mm_storeu_ps(outZ + i, rz);
+    }
+#endif
+
+    for (; i < num; i++) {
+        float px = x[i], py = y[i], pz = z[i];
+        rotateScalar(m, px, py, pz, outX[i], outY[i], outZ[i]);
+        outX[i] += m[12];
+        outY[i] += m[13];
+        outZ[i] += m[14];
+    }
+}
+
+void transformNormals(const juce::Matrix3D<float>& matrix, const float* x, const float* y, const float* z,
+    float* outX, float* outY, float* outZ, int num) {
+    auto normalMatrix = transposeMatrix(invertMatrix(matrix));
+    const float* m = normalMatrix.mat;
+    int i = 0;
+
+#if JUCE_INTEL
+    const __m128 m0 = _mm_set1_ps(m[0]), m1 = _mm_set1_ps(m[1]), m2 = _mm_set1_ps(m[2]);
+    const __m128 m4 = _mm_set1_ps(m[4]), m5 = _mm_set1_ps(m[5]), m6 = _mm_set1_ps(m[6]);
+    const __m128 m8 = _mm_set1_ps(m[8]), m9 = _mm_set1_ps(m[9]), m10 = _mm_set1_ps(m[10]);
+    const __m128 minLength = _mm_set1_ps(minNormalLengthSquared);
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    for (; i + 4 <= num; i += 4) {
+        __m128 nx = _mm_loadu_ps(x + i);
+        __m128 ny = _mm_loadu_ps(y + i);
+        __m128 nz = _mm_loadu_ps(z + i);
+
+        __m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, nx), _mm_mul_ps(m4, ny)), _mm_mul_ps(m8, nz));
+        __m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m1, nx), _mm_mul_ps(m5, ny)), _mm_mul_ps(m9, nz));
+        __m128 rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m2, nx), _mm_mul_ps(m6, ny)), _mm_mul_ps(m10, nz));
+
+        // Full precision sqrt and divide so results match the scalar path closely
+        __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry)), _mm_mul_ps(rz, rz));
+        __m128 isDegenerate = _mm_cmple_ps(lengthSquared, minLength);
+        __m128 inverseLength = _mm_div_ps(one, _mm_sqrt_ps(_mm_max_ps(lengthSquared, minLength)));
+        inverseLength = _mm_or_ps(_mm_and_ps(isDegenerate, one), _mm_andnot_ps(isDegenerate, inverseLength));
+
+        _mm_storeu_ps(outX + i, _mm_mul_ps(rx, inverseLength));
+        _mm_storeu_ps(outY + i, _mm_mul_ps(ry, inverseLength));
+        _mm_storeu_ps(outZ + i, _mm_mul_ps(rz, inverseLength));
+    }
+#endif
+
+    for (; i < num; i++) {
+        float rx, ry, rz;
+        rotateScalar(m, x[i], y[i], z[i], rx, ry, rz);
+
+        float lengthSquared = rx * rx + ry * ry + rz * rz;
+        float inverseLength = lengthSquared > minNormalLengthSquared ? 1.0f / std::sqrt(lengthSquared) : 1.0f;
+
+        outX[i] = rx * inverseLength;
+        outY[i] = ry * inverseLength;
+        outZ[i] = rz * inverseLength;
+    }
+}
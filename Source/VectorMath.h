@@ -0,0 +1,24 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Matrix helpers and batch transforms. Matrices use juce::Matrix3D's column-major layout (translation in
+// mat[12..14]), which is also how they're uploaded to the shaders, and multiplyMatrices(a, b) applies b first.
+
+juce::Matrix3D<float> multiplyMatrices(const juce::Matrix3D<float>& a, const juce::Matrix3D<float>& b);
+juce::Matrix3D<float> transposeMatrix(const juce::Matrix3D<float>& matrix);
+
+// Returns the identity and asserts if the matrix is singular
+juce::Matrix3D<float> invertMatrix(const juce::Matrix3D<float>& matrix);
+
+// Single vector versions, also the scalar reference for the batch functions below
+juce::Vector3D<float> applyTransformationMatrix(const juce::Matrix3D<float>& matrix, const juce::Vector3D<float>& point);
+juce::Vector3D<float> applyDirectionMatrix(const juce::Matrix3D<float>& matrix, const juce::Vector3D<float>& direction);
+
+// Transforms num points stored as separate x, y and z arrays. The output arrays may be the input arrays.
+void transformPoints(const juce::Matrix3D<float>& matrix, const float* x, const float* y, const float* z,
+	float* outX, float* outY, float* outZ, int num);
+
+// Transforms num normals by the inverse transpose of the matrix and renormalises them.
+// The output arrays may be the input arrays.
+void transformNormals(const juce::Matrix3D<float>& matrix, const float* x, const float* y, const float* z,
+	float* outX, float* outY, float* outZ, int num);
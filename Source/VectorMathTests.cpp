@@ -0,0 +1,122 @@
+#include "VectorMath.h"
+
+// Checks the batch and SSE paths in VectorMath against the single vector versions and juce::Matrix3D.
+// Run with juce::UnitTestRunner, category "Hedrite".
+class VectorMathTests : public juce::UnitTest {
+public:
+    VectorMathTests() : juce::UnitTest("VectorMath", "Hedrite") {}
+
+    void runTest() override {
+        auto random = getRandom();
+
+        beginTest("multiplyMatrices matches Matrix3D::operator*");
+        for (int trial = 0; trial < 100; trial++) {
+            auto a = createRandomMatrix(random);
+            auto b = createRandomMatrix(random);
+            expectMatricesEqual(multiplyMatrices(a, b), a * b);
+
+            // b is applied first
+            auto point = createRandomVector(random);
+            expectVectorsEqual(applyTransformationMatrix(multiplyMatrices(a, b), point),
+                applyTransformationMatrix(a, applyTransformationMatrix(b, point)));
+        }
+
+        beginTest("transposeMatrix");
+        for (int trial = 0; trial < 10; trial++) {
+            auto matrix = createRandomMatrix(random);
+            auto transposed = transposeMatrix(matrix);
+            for (int row = 0; row < 4; row++) {
+                for (int column = 0; column < 4; column++) {
+                    expectEquals(transposed.mat[4 * column + row], matrix.mat[4 * row + column]);
+                }
+            }
+            expectMatricesEqual(transposeMatrix(transposed), matrix);
+        }
+
+        beginTest("invertMatrix round trips");
+        for (int trial = 0; trial < 100; trial++) {
+            auto matrix = createRandomMatrix(random);
+            auto identity = juce::Matrix3D<float>();
+            expectMatricesEqual(multiplyMatrices(matrix, invertMatrix(matrix)), identity);
+            expectMatricesEqual(multiplyMatrices(invertMatrix(matrix), matrix), identity);
+        }
+
+        // Every count from 0 to 13 covers both the four at a time loop and each length of scalar tail
+        beginTest("transformPoints matches applyTransformationMatrix");
+        for (int num = 0; num <= 13; num++) {
+            checkBatch(random, num, false, false);
+            checkBatch(random, num, false, true);
+        }
+
+        beginTest("transformNormals matches the scalar inverse transpose");
+        for (int num = 0; num <= 13; num++) {
+            checkBatch(random, num, true, false);
+            checkBatch(random, num, true, true);
+        }
+    }
+
+private:
+    static constexpr float tolerance = 1.0e-4f;
+
+    // Rotation, non-uniform scale and translation, so every matrix is invertible and reasonably conditioned
+    static juce::Matrix3D<float> createRandomMatrix(juce::Random& random) {
+        auto rotation = juce::Matrix3D<float>::rotation({ random.nextFloat() * 6.0f, random.nextFloat() * 6.0f, random.nextFloat() * 6.0f });
+        auto scale = juce::Matrix3D<float>();
+        for (int i = 0; i < 3; i++) {
+            scale.mat[5 * i] = 0.5f + 2.0f * random.nextFloat();
+        }
+        auto translation = juce::Matrix3D<float>::fromTranslation(createRandomVector(random));
+        return multiplyMatrices(translation, multiplyMatrices(rotation, scale));
+    }
+
+    static juce::Vector3D<float> createRandomVector(juce::Random& random) {
+        return { 10.0f * random.nextFloat() - 5.0f, 10.0f * random.nextFloat() - 5.0f, 10.0f * random.nextFloat() - 5.0f };
+    }
+
+    static juce::Vector3D<float> transformNormal(const juce::Matrix3D<float>& matrix, const juce::Vector3D<float>& normal) {
+        auto result = applyDirectionMatrix(transposeMatrix(invertMatrix(matrix)), normal);
+        return result / result.length();
+    }
+
+    void checkBatch(juce::Random& random, int num, bool isNormals, bool isInPlace) {
+        auto matrix = createRandomMatrix(random);
+        std::vector<float> x((size_t)num), y((size_t)num), z((size_t)num);
+        std::vector<juce::Vector3D<float>> expected;
+
+        for (int i = 0; i < num; i++) {
+            auto vector = createRandomVector(random);
+            x[(size_t)i] = vector.x;
+            y[(size_t)i] = vector.y;
+            z[(size_t)i] = vector.z;
+            expected.push_back(isNormals ? transformNormal(matrix, vector) : applyTransformationMatrix(matrix, vector));
+        }
+
+        std::vector<float> outX(x), outY(y), outZ(z);
+        auto* destinationX = isInPlace ? x.data() : outX.data();
+        auto* destinationY = isInPlace ? y.data() : outY.data();
+        auto* destinationZ = isInPlace ? z.data() : outZ.data();
+
+        if (isNormals)
+            transformNormals(matrix, x.data(), y.data(), z.data(), destinationX, destinationY, destinationZ, num);
+        else
+            transformPoints(matrix, x.data(), y.data(), z.data(), destinationX, destinationY, destinationZ, num);
+
+        for (int i = 0; i < num; i++) {
+            expectVectorsEqual({ destinationX[i], destinationY[i], destinationZ[i] }, expected[(size_t)i]);
+        }
+    }
+
+    void expectMatricesEqual(const juce::Matrix3D<float>& actual, const juce::Matrix3D<float>& expected) {
+        for (int i = 0; i < 16; i++) {
+            expectWithinAbsoluteError(actual.mat[i], expected.mat[i], tolerance * juce::jmax(1.0f, std::abs(expected.mat[i])));
+        }
+    }
+
+    void expectVectorsEqual(const juce::Vector3D<float>& actual, const juce::Vector3D<float>& expected) {
+        expectWithinAbsoluteError(actual.x, expected.x, tolerance * juce::jmax(1.0f, std::abs(expected.x)));
+        expectWithinAbsoluteError(actual.y, expected.y, tolerance * juce::jmax(1.0f, std::abs(expected.y)));
+        expectWithinAbsoluteError(actual.z, expected.z, tolerance * juce::jmax(1.0f, std::abs(expected.z)));
+    }
+};
+
+static VectorMathTests vectorMathTests;
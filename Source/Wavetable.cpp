@@ -0,0 +1,385 @@
+#include "Wavetable.h"
+#include <numeric>
+
+namespace {
+    // Bump when the table layout or band-limiting changes so stale cache files are ignored
+    const juce::uint64 cacheVersion = 1;
+
+    const juce::uint64 fnvOffsetBasis = 14695981039346656037ull;
+    const juce::uint64 fnvPrime = 1099511628211ull;
+
+    juce::uint64 hashBytes(juce::uint64 hash, const void* data, size_t numBytes) {
+        auto* bytes = static_cast<const juce::uint8*>(data);
+        for (size_t i = 0; i < numBytes; i++) {
+            hash = (hash ^ bytes[i]) * fnvPrime;
+        }
+        return hash;
+    }
+
+    size_t getNumLevelSamples() {
+        return (size_t)MipmappedWavetable::numLevels * (MipmappedWavetable::tableSize + 1);
+    }
+
+    float cross(juce::Point<float> a, juce::Point<float> b) {
+        return a.x * b.y - a.y * b.x;
+    }
+}
+
+/*
+*   MipmappedWavetable
+*/
+MipmappedWavetable::MipmappedWavetable(const std::vector<float>& singleCycle) {
+    jassert(!singleCycle.empty());
+
+    // Resample to the table size if needed; the FFT wants exactly one table of input
+    std::vector<float> spectrum(2 * tableSize, 0.0f);
+    for (int i = 0; i < tableSize; i++) {
+        auto position = (double)i * (double)singleCycle.size() / (double)tableSize;
+        auto index = (size_t)position;
+        auto fraction = (float)(position - (double)index);
+        auto next = (index + 1) % singleCycle.size();
+        spectrum[i] = singleCycle[index] + fraction * (singleCycle[next] - singleCycle[index]);
+    }
+
+    juce::dsp::FFT fft(tableOrder);
+    fft.performRealOnlyForwardTransform(spectrum.data());
+
+    levels.resize(getNumLevelSamples());
+    std::vector<float> work(2 * tableSize);
+
+    for (int level = 0; level < numLevels; level++) {
+        auto highestHarmonic = jmax(1, maxHarmonics >> level);
+        std::copy(spectrum.begin(), spectrum.end(), work.begin());
+
+        // Remove DC and every harmonic above this level's limit, keeping the spectrum conjugate symmetric
+        work[0] = work[1] = 0.0f;
+        for (int bin = highestHarmonic + 1; bin <= tableSize / 2; bin++) {
+            work[2 * bin] = work[2 * bin + 1] = 0.0f;
+            work[2 * (tableSize - bin)] = work[2 * (tableSize - bin) + 1] = 0.0f;
+        }
+
+        fft.performRealOnlyInverseTransform(work.data());
+
+        float* table = levels.data() + (size_t)level * (tableSize + 1);
+        std::copy(work.begin(), work.begin() + tableSize, table);
+        table[tableSize] = table[0];
+    }
+
+    // One gain for every level so switching levels between notes doesn't change the loudness
+    auto range = juce::FloatVectorOperations::findMinAndMax(levels.data(), tableSize + 1);
+    auto peak = jmax(std::abs(range.getStart()), std::abs(range.getEnd()));
+    if (peak > 0.0f) {
+        juce::FloatVectorOperations::multiply(levels.data(), 1.0f / peak, (int)levels.size());
+    }
+}
+
+std::unique_ptr<MipmappedWavetable> MipmappedWavetable::readFromFile(const juce::File& file) {
+    auto numBytes = getNumLevelSamples() * sizeof(float);
+    if (file.getSize() != (juce::int64)numBytes)
+        return nullptr;
+
+    juce::FileInputStream input(file);
+    if (input.failedToOpen())
+        return nullptr;
+
+    std::unique_ptr<MipmappedWavetable> table(new MipmappedWavetable());
+    table->levels.resize(getNumLevelSamples());
+    if (input.read(table->levels.data(), (int)numBytes) != (int)numBytes)
+        return nullptr;
+
+    return table;
+}
+
+bool MipmappedWavetable::writeToFile(const juce::File& file) const {
+    if (!file.getParentDirectory().createDirectory())
+        return false;
+
+    // Write next to the target and move it into place, so a reader never sees a half written file
+    juce::TemporaryFile temporaryFile(file);
+    {
+        juce::FileOutputStream output(temporaryFile.getFile());
+        if (output.failedToOpen())
+            return false;
+
+        if (!output.write(levels.data(), levels.size() * sizeof(float)))
+            return false;
+    }
+    return temporaryFile.overwriteTargetFileWithTemporary();
+}
+
+juce::uint64 MipmappedWavetable::getContentHash(const std::vector<float>& singleCycle) {
+    juce::uint64 layout[] = { cacheVersion, (juce::uint64)tableSize, (juce::uint64)maxHarmonics, (juce::uint64)numLevels };
+    auto hash = hashBytes(fnvOffsetBasis, layout, sizeof(layout));
+    return hashBytes(hash, singleCycle.data(), singleCycle.size() * sizeof(float));
+}
+
+std::vector<float> MipmappedWavetable::createSilhouetteCycle(const std::vector<Vector3D<float>>& points) {
+    // Convex hull of the projected points (monotone chain), counter-clockwise
+    std::vector<juce::Point<float>> projected;
+    for (auto& p : points) {
+        projected.push_back({ p.x, p.y });
+    }
+    std::sort(projected.begin(), projected.end(), [](juce::Point<float> a, juce::Point<float> b) {
+        return a.x < b.x || (a.x == b.x && a.y < b.y);
+    });
+
+    std::vector<juce::Point<float>> hull;
+    for (int pass = 0; pass < 2; pass++) {
+        auto start = hull.size();
+        for (auto& p : projected) {
+            while (hull.size() >= start + 2 && cross(hull.back() - hull[hull.size() - 2], p - hull[hull.size() - 2]) <= 0.0f) {
+                hull.pop_back();
+            }
+            hull.push_back(p);
+        }
+        hull.pop_back();
+        std::reverse(projected.begin(), projected.end());
+    }
+
+    std::vector<float> cycle(tableSize);
+
+    if (hull.size() < 3) {
+        for (int i = 0; i < tableSize; i++) {
+            cycle[i] = std::sin(juce::MathConstants<float>::twoPi * (float)i / (float)tableSize);
+        }
+        return cycle;
+    }
+
+    juce::Point<float> centre;
+    for (auto& p : hull) {
+        centre += p;
+    }
+    centre /= (float)hull.size();
+
+    // Distance from the centre to the outline along each angle of the cycle
+    for (int i = 0; i < tableSize; i++) {
+        auto angle = juce::MathConstants<float>::twoPi * (float)i / (float)tableSize;
+        juce::Point<float> direction(std::cos(angle), std::sin(angle));
+        auto radius = 0.0f;
+
+        for (size_t e = 0; e < hull.size(); e++) {
+            auto a = hull[e];
+            auto edge = hull[(e + 1) % hull.size()] - a;
+            auto denominator = cross(direction, edge);
+            if (std::abs(denominator) < 1.0e-9f)
+                continue;
+
+            auto t = cross(a - centre, edge) / denominator;
+            auto s = cross(a - centre, direction) / denominator;
+            if (t > 0.0f && s >= 0.0f && s <= 1.0f) {
+                radius = t;
+                break;
+            }
+        }
+        cycle[i] = radius;
+    }
+
+    auto mean = std::accumulate(cycle.begin(), cycle.end(), 0.0f) / (float)tableSize;
+    juce::FloatVectorOperations::add(cycle.data(), -mean, tableSize);
+    return cycle;
+}
+
+int MipmappedWavetable::getLevelForFrequency(double frequency, double sampleRate) {
+    if (frequency <= 0.0)
+        return 0;
+
+    // Smallest level whose highest harmonic still fits below Nyquist
+    auto allowedHarmonics = sampleRate * 0.5 / frequency;
+    if (allowedHarmonics >= (double)maxHarmonics)
+        return 0;
+
+    auto level = (int)std::ceil(std::log2((double)maxHarmonics / jmax(1.0, allowedHarmonics)));
+    return jlimit(0, numLevels - 1, level);
+}
+
+/*
+*   WavetableBank
+*/
+WavetableBank::WavetableBank() : juce::Thread("Wavetable builder") {
+    allRequestsBuilt.signal();
+    startThread();
+}
+
+WavetableBank::~WavetableBank() {
+    stopThread(2000);
+    deleteRetiredTables();
+    delete pendingTable.exchange(nullptr);
+    delete currentTable;
+}
+
+void WavetableBank::requestTable(const std::vector<float>& singleCycle) {
+    {
+        const RealtimeGuard::ScopedLock lock(requestLock);
+        requestedCycle = singleCycle;
+        hasRequest = true;
+        allRequestsBuilt.reset();
+    }
+    notify();
+}
+
+bool WavetableBank::waitUntilBuilt(int timeoutMilliseconds) {
+    return allRequestsBuilt.wait(timeoutMilliseconds);
+}
+
+const MipmappedWavetable* WavetableBank::acquireForAudio() {
+    // Only swap when the old table has somewhere to go, so nothing is ever freed on the audio thread
+    if (retiredFifo.getFreeSpace() > 0) {
+        if (auto* nextTable = pendingTable.exchange(nullptr)) {
+            if (currentTable != nullptr) {
+                auto scope = retiredFifo.write(1);
+                retiredTables[scope.startIndex1] = currentTable;
+            }
+            currentTable = nextTable;
+        }
+    }
+    return currentTable;
+}
+
+juce::File WavetableBank::getCacheDirectory() {
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+        .getChildFile("Hedrite")
+        .getChildFile("Wavetables");
+}
+
+void WavetableBank::run() {
+    while (!threadShouldExit()) {
+        deleteRetiredTables();
+
+        std::vector<float> cycle;
+        bool hasWork = false;
+        {
+            const RealtimeGuard::ScopedLock lock(requestLock);
+            if (hasRequest) {
+                cycle.swap(requestedCycle);
+                hasRequest = false;
+                hasWork = true;
+            }
+        }
+
+        if (hasWork) {
+            auto table = buildOrLoad(cycle);
+
+            // A table the audio thread never picked up can be replaced and freed here
+            delete pendingTable.exchange(table.release());
+
+            const RealtimeGuard::ScopedLock lock(requestLock);
+            if (!hasRequest) {
+                allRequestsBuilt.signal();
+            }
+        }
+
+        wait(100);
+    }
+}
+
+std::unique_ptr<MipmappedWavetable> WavetableBank::buildOrLoad(const std::vector<float>& singleCycle) {
+    auto hash = MipmappedWavetable::getContentHash(singleCycle);
+    auto cacheFile = getCacheDirectory().getChildFile(juce::String::toHexString((juce::int64)hash) + ".wavetable");
+
+    if (auto cached = MipmappedWavetable::readFromFile(cacheFile))
+        return cached;
+
+    auto table = std::make_unique<MipmappedWavetable>(singleCycle);
+    if (!table->writeToFile(cacheFile)) {
+        DBG("--- Couldn't cache wavetable to " + cacheFile.getFullPathName() + " ---");
+    }
+    return table;
+}
+
+void WavetableBank::deleteRetiredTables() {
+    auto scope = retiredFifo.read(retiredFifo.getNumReady());
+    for (int i = 0; i < scope.blockSize1; i++) {
+        delete retiredTables[scope.startIndex1 + i];
+    }
+    for (int i = 0; i < scope.blockSize2; i++) {
+        delete retiredTables[scope.startIndex2 + i];
+    }
+}
+
+/*
+*   WavetableVoice
+*/
+WavetableVoice::WavetableVoice() {
+    envelope.setParameters({ 0.005f, 0.2f, 0.7f, releaseSeconds });
+}
+
+void WavetableVoice::setWavetable(const MipmappedWavetable* table) {
+    wavetable = table;
+}
+
+bool WavetableVoice::canPlaySound(juce::SynthesiserSound* sound) {
+    return dynamic_cast<WavetableSound*>(sound) != nullptr;
+}
+
+void WavetableVoice::startNote(int midiNoteNumber, float velocity, juce::SynthesiserSound*, int) {
+    frequency = juce::MidiMessage::getMidiNoteInHertz(midiNoteNumber);
+    phase = 0.0;
+    gain = 0.25f * velocity;
+    updateFrequency();
+    envelope.noteOn();
+}
+
+void WavetableVoice::stopNote(float, bool allowTailOff) {
+    if (allowTailOff) {
+        envelope.noteOff();
+    }
+    else {
+        envelope.reset();
+        clearCurrentNote();
+    }
+}
+
+void WavetableVoice::pitchWheelMoved(int) {
+}
+
+void WavetableVoice::controllerMoved(int, int) {
+}
+
+void WavetableVoice::setCurrentPlaybackSampleRate(double newRate) {
+    juce::SynthesiserVoice::setCurrentPlaybackSampleRate(newRate);
+    if (newRate > 0.0) {
+        envelope.setSampleRate(newRate);
+        updateFrequency();
+    }
+}
+
+void WavetableVoice::updateFrequency() {
+    auto sampleRate = getSampleRate();
+    if (sampleRate <= 0.0)
+        return;
+
+    phaseIncrement = frequency / sampleRate;
+    level = MipmappedWavetable::getLevelForFrequency(frequency, sampleRate);
+}
+
+void WavetableVoice::renderNextBlock(juce::AudioBuffer<float>& outputBuffer, int startSample, int numSamples) {
+    if (!isVoiceActive())
+        return;
+
+    auto numChannels = outputBuffer.getNumChannels();
+
+    // With no table yet the voice is silent, but its envelope still runs so released notes end and free the voice
+    if (wavetable == nullptr) {
+        for (int i = 0; i < numSamples; i++) {
+            envelope.getNextSample();
+        }
+        phase = std::fmod(phase + phaseIncrement * numSamples, 1.0);
+    }
+    else {
+        for (int i = 0; i < numSamples; i++) {
+            auto sample = wavetable->getSample(phase, level) * gain * envelope.getNextSample();
+
+            for (int channel = 0; channel < numChannels; channel++) {
+                outputBuffer.addSample(channel, startSample + i, sample);
+            }
+
+            phase += phaseIncrement;
+            if (phase >= 1.0)
+                phase -= 1.0;
+        }
+    }
+
+    if (!envelope.isActive()) {
+        clearCurrentNote();
+    }
+}
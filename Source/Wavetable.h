@@ -0,0 +1,120 @@
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+#include <vector>
+#include "RealtimeGuard.h"
+
+// A single cycle waveform band-limited into one table per octave. Level k keeps half the harmonics of level k - 1,
+// so picking the level by note frequency keeps every harmonic below Nyquist and a linear lookup is all a voice needs.
+class MipmappedWavetable {
+public:
+	static constexpr int tableOrder = 11;
+	static constexpr int tableSize = 1 << tableOrder;
+
+	// Harmonics stop at a quarter of the table size so linear interpolation stays accurate
+	static constexpr int maxHarmonics = tableSize / 4;
+	static constexpr int numLevels = 10;
+
+	// Builds the levels with an FFT; expensive, so only call this off the audio thread
+	explicit MipmappedWavetable(const std::vector<float>& singleCycle);
+
+	static std::unique_ptr<MipmappedWavetable> readFromFile(const juce::File& file);
+	bool writeToFile(const juce::File& file) const;
+
+	static juce::uint64 getContentHash(const std::vector<float>& singleCycle);
+
+	// Single cycle traced by the distance from the centre to the outline of the points projected onto the xy plane
+	static std::vector<float> createSilhouetteCycle(const std::vector<Vector3D<float>>& points);
+
+	static int getLevelForFrequency(double frequency, double sampleRate);
+
+	// phase is in [0, 1)
+	inline float getSample(double phase, int level) const {
+		auto position = phase * (double)tableSize;
+		auto index = (int)position;
+		auto fraction = (float)(position - (double)index);
+		const float* table = levels.data() + (size_t)level * (tableSize + 1);
+		return table[index] + fraction * (table[index + 1] - table[index]);
+	}
+
+private:
+	MipmappedWavetable() = default;
+
+	// numLevels tables of tableSize samples, each followed by a copy of its first sample for interpolation
+	std::vector<float> levels;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MipmappedWavetable)
+};
+
+// Builds wavetables on a background thread, caching them on disk by content hash, and hands finished
+// tables to the audio thread without locking or freeing memory there.
+class WavetableBank : private juce::Thread {
+public:
+	WavetableBank();
+	~WavetableBank() override;
+
+	void requestTable(const std::vector<float>& singleCycle);
+
+	// Blocks until every requested table has been built; returns false on timeout
+	bool waitUntilBuilt(int timeoutMilliseconds);
+
+	// Audio thread: picks up a newly built table if there is one and returns the table to play, or nullptr before the first build
+	const MipmappedWavetable* acquireForAudio();
+
+	static juce::File getCacheDirectory();
+
+private:
+	static constexpr int maxRetiredTables = 16;
+
+	void run() override;
+	std::unique_ptr<MipmappedWavetable> buildOrLoad(const std::vector<float>& singleCycle);
+	void deleteRetiredTables();
+
+	RealtimeGuard::CheckedCriticalSection requestLock;
+	std::vector<float> requestedCycle;
+	bool hasRequest = false;
+	juce::WaitableEvent allRequestsBuilt{ true };
+
+	std::atomic<MipmappedWavetable*> pendingTable{ nullptr };
+	MipmappedWavetable* currentTable = nullptr;
+
+	// Tables replaced on the audio thread wait here until the builder thread deletes them
+	juce::AbstractFifo retiredFifo{ maxRetiredTables };
+	MipmappedWavetable* retiredTables[maxRetiredTables];
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WavetableBank)
+};
+
+struct WavetableSound : public juce::SynthesiserSound {
+	bool appliesToNote(int) override { return true; }
+	bool appliesToChannel(int) override { return true; }
+};
+
+class WavetableVoice : public juce::SynthesiserVoice {
+public:
+	static constexpr float releaseSeconds = 0.4f;
+
+	WavetableVoice();
+
+	void setWavetable(const MipmappedWavetable* table);
+
+	bool canPlaySound(juce::SynthesiserSound* sound) override;
+	void startNote(int midiNoteNumber, float velocity, juce::SynthesiserSound* sound, int currentPitchWheelPosition) override;
+	void stopNote(float velocity, bool allowTailOff) override;
+	void pitchWheelMoved(int newPitchWheelValue) override;
+	void controllerMoved(int controllerNumber, int newControllerValue) override;
+	void setCurrentPlaybackSampleRate(double newRate) override;
+	void renderNextBlock(juce::AudioBuffer<float>& outputBuffer, int startSample, int numSamples) override;
+
+private:
+	void updateFrequency();
+
+	const MipmappedWavetable* wavetable = nullptr;
+	juce::ADSR envelope;
+
+	double frequency = 0.0;
+	double phase = 0.0;
+	double phaseIncrement = 0.0;
+	int level = 0;
+	float gain = 0.0f;
+};
@@ -0,0 +1,27 @@
+/*
+  ==============================================================================
+
+    Runs every juce::UnitTest linked in, Hedrite's among them. Exits with 1 if
+    any of them failed, so a build script can stop on it.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    // The processor's parameters and the editor's classes expect JUCE's message loop to exist
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::UnitTestRunner runner;
+    runner.setAssertOnFailure (false);
+    runner.runAllTests();
+
+    int numFailures = 0;
+    for (int i = 0; i < runner.getNumResults(); ++i)
+        numFailures += runner.getResult (i)->failures;
+
+    return numFailures > 0 ? 1 : 0;
+}